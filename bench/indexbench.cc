@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+//
+//     Index lookup latency of the different index backends
+//
+//------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "common/timehelper.h"
+#include "../tskiplist/Epoch.h"
+#include "../tskiplist/Index.h"
+
+typedef Node<int, int> IndexNode;
+
+// Indexes the keys 0, 2, ..., 2 * (size - 1) in random order, then looks up
+// random keys of the same range with getPrev.
+template<typename Backend>
+void TestBackend(const char* name, uint32_t size, uint32_t lookups)
+{
+    std::mt19937 randomGen(size);
+    std::vector<IndexNode*> nodes;
+    nodes.reserve(size);
+    std::vector<int> keys(lookups);
+    for(auto& key : keys)
+    {
+        key = randomGen() % (2 * size);
+    }
+
+    double buildTime, lookupTime;
+    long checksum = 0;
+    {
+        Index<int, int, std::less<int>, Backend> index(0);
+        EpochGuard guard;
+
+        for(uint32_t i = 0; i < size; ++i)
+        {
+            nodes.push_back(IndexNode::create(2 * i, i, 0, index.chooseTopLayer()));
+        }
+        std::shuffle(nodes.begin(), nodes.end(), randomGen);
+
+        double startTime = Time::GetWallTime();
+        for(auto node : nodes)
+        {
+            index.insert(node);
+        }
+        buildTime = Time::GetWallTime() - startTime;
+
+        startTime = Time::GetWallTime();
+        for(auto key : keys)
+        {
+            checksum += index.getPrev(key)->key;
+        }
+        lookupTime = Time::GetWallTime() - startTime;
+    }
+
+    for(auto node : nodes)
+    {
+        node->destroy();
+    }
+
+    printf("%-10s %10u keys: %8.1f ns/insert %8.1f ns/lookup (checksum %ld)\n", name, size,
+           buildTime * 1e9 / size, lookupTime * 1e9 / lookups, checksum);
+}
+
+int main(int argc, const char *argv[])
+{
+    uint32_t lookups = 2000000;
+    std::vector<uint32_t> sizes = { 1000000, 10000000, 100000000 };
+
+    if(argc > 1) lookups = atoi(argv[1]);
+    if(argc > 2)
+    {
+        sizes.clear();
+        for(int i = 2; i < argc; ++i)
+        {
+            sizes.push_back(atoi(argv[i]));
+        }
+    }
+
+    printf("Start testing index lookups, %d per index size.\n", lookups);
+
+    for(auto size : sizes)
+    {
+        TestBackend<RawSkipListBackend<int, int>>("skiplist", size, lookups);
+        TestBackend<RawSkipListBackend<int, int, std::less<int>, true>>("lockfree", size, lookups);
+        TestBackend<KeySkipListBackend<int, int>>("keyindex", size, lookups);
+        TestBackend<BTreeBackend<int, int>>("btree", size, lookups);
+    }
+
+    return 0;
+}
@@ -236,7 +236,7 @@ void destroy_transskip_subsystem(void)
     fr_destroy_gc_subsystem();
 }
 
-static inline bool help_ops(SkipList &l, Desc* desc, uint8_t opid)
+static inline bool help_ops(SkipList<> &l, Desc* desc, uint8_t opid)
 {
     bool ret = true;
     // For less than 1 million nodes, it is faster not to delete nodes
@@ -253,13 +253,19 @@ static inline bool help_ops(SkipList &l, Desc* desc, uint8_t opid)
         }
         return false;
     }
-    SkipListTransaction t;
+    static thread_local SkipListTransaction t;
 
     helpStack.Push(desc);
     try {
 
 
-        l.TXBegin(t);
+        bool readOnly = true;
+        for(uint8_t i = opid; i < desc->size; i++)
+        {
+            readOnly = readOnly && desc->ops[i].type == O_FIND;
+        }
+
+        l.TXBegin(t, readOnly ? TX_READ_ONLY : TX_READ_WRITE);
         while(desc->status == LIVE && ret && opid < desc->size)
         {
             const Operator& op = desc->ops[opid];
@@ -283,6 +289,7 @@ static inline bool help_ops(SkipList &l, Desc* desc, uint8_t opid)
         __sync_fetch_and_add(&g_count_commit, 1);
     }
     catch (AbortTransactionException e){
+        l.TXAbort(t);
         __sync_fetch_and_add(&g_count_abort, 1);
     }
     helpStack.Pop();
@@ -291,7 +298,7 @@ static inline bool help_ops(SkipList &l, Desc* desc, uint8_t opid)
 }
 
 
-bool execute_ops(SkipList &l, Desc* desc)
+bool execute_ops(SkipList<> &l, Desc* desc)
 {
     helpStack.Init();
 
@@ -311,16 +318,30 @@ void transskip_print(trans_skip* l)
     }
 }
 
-void transskip_free(SkipList &l)
+void transskip_free(SkipList<> &l)
 {
     printf("Total commits: %u\nTotal aborts: %u\nTotal fakes: %u\n", g_count_commit, g_count_abort, g_count_fake_abort);
 
+    FilterStats filter = WriteSet::totalFilterStats();
+    printf("Write-set lookups: %llu\nWrite-set filter hits: %llu\nWrite-set false positives: %llu\n",
+           (unsigned long long)filter.lookups, (unsigned long long)filter.filtered,
+           (unsigned long long)filter.falsePositives);
+
+    AbortStats aborts = l.abortStats();
+    printf("Abort causes:\n");
+    for (int i = 0; i < NUM_ABORT_CAUSES; i++) {
+        printf("  %s: %llu\n", AbortStats::causeName((AbortCause)i),
+               (unsigned long long)aborts.counts[i]);
+    }
+
     //transskip_print(l);
 }
 
-void ResetMetrics(SkipList &l)
+void ResetMetrics(SkipList<> &l)
 {
     g_count_commit = 0;
     g_count_abort = 0;
     g_count_fake_abort = 0;
+    WriteSet::resetFilterStats();
+    l.resetAbortStats();
 }
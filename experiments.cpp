@@ -3,6 +3,7 @@
 #include <random>
 #include <thread>
 #include <atomic>
+#include <algorithm>
 
 #include "tskiplist/Utils.h"
 #include "tskiplist/TSkipList.h"
@@ -16,13 +17,31 @@ enum WorkloadType
     UPDATE_ONLY = 2
 };
 
+// How workers learn about aborts; COMPARE_ABORT_APIS runs the workload once
+// with each of the first two. The RETRY_* workers rerun aborted transactions
+// through SkipList::atomically and count every retry as an abort.
+// SINGLETON_OPS runs every operation on its own, without a transaction.
+enum AbortApi
+{
+    ABORT_BY_EXCEPTION = 0,
+    ABORT_BY_STATUS = 1,
+    COMPARE_ABORT_APIS = 2,
+    RETRY_WITH_BACKOFF = 3,
+    RETRY_WITH_KARMA = 4,
+    RETRY_IRREVOCABLE = 5,
+    SINGLETON_OPS = 6
+};
+
+// Aborts after which RETRY_IRREVOCABLE reruns a transaction irrevocably.
+unsigned int constexpr IRREVOCABLE_AFTER = 8;
+
 unsigned int constexpr WARM_UP_NUM_KEYS = 100000;
 unsigned int constexpr MIN_KEY_VAL = 1;
 unsigned int constexpr MAX_KEY_VAL = 1000000;
 unsigned int constexpr TIMEOUT = 10;
 
 
-void warmUp(SkipList & sl)
+void warmUp(SkipList<> & sl)
 {
     minstd_rand generator;
     uniform_int_distribution<int> distribution(MIN_KEY_VAL, MAX_KEY_VAL);
@@ -31,10 +50,18 @@ void warmUp(SkipList & sl)
     for (auto i = 0; i < WARM_UP_NUM_KEYS; i++) {
         int percent = (int)((i / float(WARM_UP_NUM_KEYS)) * 100);
 
+        const int key = distribution(generator);
         SkipListTransaction trans;
-        sl.TXBegin(trans);
-        sl.insert(distribution(generator), trans);
-        sl.TXCommit(trans);
+        for (;;) {
+            try {
+                sl.TXBegin(trans);
+                sl.insert(key, trans);
+                sl.TXCommit(trans);
+                break;
+            } catch (AbortTransactionException &) {
+                // Lazy clock modes abort once after an unpublished commit
+            }
+        }
     }
 
     cout << "Finished" << endl;
@@ -76,7 +103,7 @@ void chooseOps(WorkloadType wtype, uint32_t numOps,
     }
 }
 
-void performOp(SkipList * sl, OperationType & opType,
+void performOp(SkipList<> * sl, OperationType & opType,
                SkipListTransaction & trans,
                int key)
 {
@@ -90,7 +117,19 @@ void performOp(SkipList * sl, OperationType & opType,
     }
 }
 
-void worker(SkipList * sl, atomic<uint32_t> * opsCounter,
+OpResult performOpNoThrow(SkipList<> * sl, OperationType & opType,
+                          SkipListTransaction & trans,
+                          int key)
+{
+    if (opType == OperationType::CONTAINS) {
+        return sl->tryContains(key, trans);
+    } else if (opType == OperationType::INSERT) {
+        return sl->tryInsert(key, trans);
+    }
+    return sl->tryRemove(key, trans);
+}
+
+void worker(SkipList<> * sl, atomic<uint32_t> * opsCounter,
             atomic<uint32_t> * abortCounter,
             WorkloadType wtype, time_t end)
 {
@@ -98,14 +137,19 @@ void worker(SkipList * sl, atomic<uint32_t> * opsCounter,
     uniform_int_distribution<int> key_distribution(MIN_KEY_VAL, MAX_KEY_VAL);
     uniform_int_distribution<uint32_t> transaction_distribution(1, 7);
 
+    SkipListTransaction trans;
     while (time(NULL) < end) {
         int numOps = transaction_distribution(generator);
 
         vector<OperationType> ops(numOps);
         chooseOps(wtype, numOps, ops);
 
-        SkipListTransaction trans;
-        sl->TXBegin(trans);
+        const bool readOnly = all_of(ops.begin(), ops.end(),
+        [](OperationType op) {
+            return op == OperationType::CONTAINS;
+        });
+
+        sl->TXBegin(trans, readOnly ? TX_READ_ONLY : TX_READ_WRITE);
         try {
             for (uint32_t i = 0; i < numOps; i++) {
                 int key = key_distribution(generator);
@@ -119,23 +163,106 @@ void worker(SkipList * sl, atomic<uint32_t> * opsCounter,
     }
 }
 
-int main(int argc, char * argv[])
+void workerNoThrow(SkipList<> * sl, atomic<uint32_t> * opsCounter,
+                   atomic<uint32_t> * abortCounter,
+                   WorkloadType wtype, time_t end)
 {
-    if (argc != 3) {
-        cout << "Invalid number of parameters" << endl;
-        cout << "Usage: " << argv[0] << " <WORKLOAD_TYPE> <NUM_THREADS>" << endl;
-        cout << "Workload types: 0 = READ_ONLY, 1 = MIXED, 2 = UPDATE_ONLY" << endl;
-        return 1;
+    minstd_rand generator;
+    uniform_int_distribution<int> key_distribution(MIN_KEY_VAL, MAX_KEY_VAL);
+    uniform_int_distribution<uint32_t> transaction_distribution(1, 7);
+
+    SkipListTransaction trans;
+    while (time(NULL) < end) {
+        int numOps = transaction_distribution(generator);
+
+        vector<OperationType> ops(numOps);
+        chooseOps(wtype, numOps, ops);
+
+        const bool readOnly = all_of(ops.begin(), ops.end(),
+        [](OperationType op) {
+            return op == OperationType::CONTAINS;
+        });
+
+        sl->TXBegin(trans, readOnly ? TX_READ_ONLY : TX_READ_WRITE);
+        for (uint32_t i = 0; i < numOps && !trans.aborted; i++) {
+            int key = key_distribution(generator);
+            performOpNoThrow(sl, ops[i], trans, key);
+        }
+        if (sl->TXTryCommit(trans)) {
+            atomic_fetch_add<uint32_t>(opsCounter, numOps);
+        } else {
+            atomic_fetch_add<uint32_t>(abortCounter, 1);
+        }
     }
+}
 
-    srand(time(NULL));
+void workerRetry(SkipList<> * sl, atomic<uint32_t> * opsCounter,
+                 atomic<uint32_t> * abortCounter,
+                 WorkloadType wtype, time_t end, RetryPolicy retryPolicy)
+{
+    minstd_rand generator;
+    uniform_int_distribution<int> key_distribution(MIN_KEY_VAL, MAX_KEY_VAL);
+    uniform_int_distribution<uint32_t> transaction_distribution(1, 7);
 
-    WorkloadType wtype = (WorkloadType)(atoi(argv[1]));
+    while (time(NULL) < end) {
+        int numOps = transaction_distribution(generator);
+
+        vector<OperationType> ops(numOps);
+        chooseOps(wtype, numOps, ops);
+        vector<int> keys(numOps);
+        for (auto & key : keys) {
+            key = key_distribution(generator);
+        }
+
+        const bool readOnly = all_of(ops.begin(), ops.end(),
+        [](OperationType op) {
+            return op == OperationType::CONTAINS;
+        });
+
+        const unsigned int retries = sl->atomically([&](SkipListTransaction & trans) {
+            for (uint32_t i = 0; i < numOps; i++) {
+                performOp(sl, ops[i], trans, keys[i]);
+            }
+        }, retryPolicy, readOnly ? TX_READ_ONLY : TX_READ_WRITE);
+        atomic_fetch_add<uint32_t>(opsCounter, numOps);
+        atomic_fetch_add<uint32_t>(abortCounter, retries);
+    }
+}
+
+void workerSingleton(SkipList<> * sl, atomic<uint32_t> * opsCounter,
+                     WorkloadType wtype, time_t end)
+{
+    minstd_rand generator;
+    uniform_int_distribution<int> key_distribution(MIN_KEY_VAL, MAX_KEY_VAL);
+    uniform_int_distribution<uint32_t> transaction_distribution(1, 7);
+
+    while (time(NULL) < end) {
+        int numOps = transaction_distribution(generator);
+
+        vector<OperationType> ops(numOps);
+        chooseOps(wtype, numOps, ops);
+        for (uint32_t i = 0; i < numOps; i++) {
+            int key = key_distribution(generator);
+            if (ops[i] == OperationType::CONTAINS) {
+                sl->singletonContains(key);
+            } else if (ops[i] == OperationType::INSERT) {
+                sl->singletonInsert(key);
+            } else {
+                sl->singletonRemove(key);
+            }
+        }
+        atomic_fetch_add<uint32_t>(opsCounter, numOps);
+    }
+}
 
-    SkipList sl;
+void runWorkload(WorkloadType wtype, uint32_t numThreads, GVCMode gvcMode,
+                 AbortApi abortApi)
+{
+    SkipList<> sl(gvcMode);
     warmUp(sl);
+    WriteSet::resetFilterStats();
+    SkipList<>::resetAbortStats();
 
-    uint32_t numThreads = atoi(argv[2]);
     vector<thread> threads;
 
     time_t end = time(NULL) + TIMEOUT;
@@ -144,8 +271,20 @@ int main(int argc, char * argv[])
     atomic<uint32_t> abortCounter(0);
 
     for (uint32_t i = 0; i < numThreads; i++) {
-        threads.push_back(thread(worker, &sl, &opsCounter, &abortCounter,
-                                 wtype, end));
+        if (abortApi == ABORT_BY_STATUS) {
+            threads.push_back(thread(workerNoThrow, &sl, &opsCounter,
+                                     &abortCounter, wtype, end));
+        } else if (abortApi == SINGLETON_OPS) {
+            threads.push_back(thread(workerSingleton, &sl, &opsCounter, wtype, end));
+        } else if (abortApi >= RETRY_WITH_BACKOFF) {
+            const RetryPolicy policy(abortApi == RETRY_WITH_KARMA ? CM_KARMA : CM_BACKOFF, 0,
+                                     abortApi == RETRY_IRREVOCABLE ? IRREVOCABLE_AFTER : 0);
+            threads.push_back(thread(workerRetry, &sl, &opsCounter,
+                                     &abortCounter, wtype, end, policy));
+        } else {
+            threads.push_back(thread(worker, &sl, &opsCounter, &abortCounter,
+                                     wtype, end));
+        }
     }
 
     for (auto & t : threads) {
@@ -154,5 +293,51 @@ int main(int argc, char * argv[])
 
     cout << "Num ops: " << opsCounter << endl;
     cout << "Num aborts: " << abortCounter << endl;
+
+    // Transactions report their filter counts as they finish.
+    FilterStats filter = WriteSet::totalFilterStats();
+    cout << "Write-set lookups: " << filter.lookups
+         << " filter hits: " << filter.filtered
+         << " false positives: " << filter.falsePositives << endl;
+
+    AbortStats aborts = SkipList<>::abortStats();
+    cout << "Abort causes:";
+    for (int i = 0; i < NUM_ABORT_CAUSES; i++) {
+        cout << (i == 0 ? " " : ", ") << AbortStats::causeName((AbortCause)i)
+             << ": " << aborts.counts[i];
+    }
+    cout << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3 || argc > 5) {
+        cout << "Invalid number of parameters" << endl;
+        cout << "Usage: " << argv[0] << " <WORKLOAD_TYPE> <NUM_THREADS> [GVC_MODE] [ABORT_API]" << endl;
+        cout << "Workload types: 0 = READ_ONLY, 1 = MIXED, 2 = UPDATE_ONLY" << endl;
+        cout << "GVC modes: 0 = GV1 (default), 1 = GV4, 2 = GV5, 3 = GV6, 4 = GV_BATCHED" << endl;
+        cout << "Abort APIs: 0 = exceptions (default), 1 = status codes, 2 = compare both," << endl;
+        cout << "            3 = retry with backoff, 4 = retry with karma," << endl;
+        cout << "            5 = retry with backoff, irrevocably after " << IRREVOCABLE_AFTER
+             << " aborts," << endl;
+        cout << "            6 = singleton operations (no transactions)" << endl;
+        return 1;
+    }
+
+    srand(time(NULL));
+
+    WorkloadType wtype = (WorkloadType)(atoi(argv[1]));
+    uint32_t numThreads = atoi(argv[2]);
+    GVCMode gvcMode = argc >= 4 ? (GVCMode)(atoi(argv[3])) : GV1;
+    AbortApi abortApi = argc >= 5 ? (AbortApi)(atoi(argv[4])) : ABORT_BY_EXCEPTION;
+
+    if (abortApi == COMPARE_ABORT_APIS) {
+        cout << "Abort API: exceptions" << endl;
+        runWorkload(wtype, numThreads, gvcMode, ABORT_BY_EXCEPTION);
+        cout << "Abort API: status codes" << endl;
+        runWorkload(wtype, numThreads, gvcMode, ABORT_BY_STATUS);
+    } else {
+        runWorkload(wtype, numThreads, gvcMode, abortApi);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,16 @@
 #include "gtest/gtest.h"
 
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+
+#include "tskiplist/BTree.h"
+#include "tskiplist/Epoch.h"
 #include "tskiplist/Index.h"
+#include "tskiplist/KeySkipList.h"
+#include "tskiplist/SlabAllocator.h"
 #include "tskiplist/TSkipList.h"
 
 class TDSLTest : public ::testing::Test
@@ -19,7 +29,7 @@ public:
     }
 };
 
-void initSkipList(SkipList & sl)
+void initSkipList(SkipList<> & sl)
 {
     SkipListTransaction trans;
     sl.TXBegin(trans);
@@ -34,7 +44,7 @@ void initSkipList(SkipList & sl)
 
 TEST_F(TDSLTest, SkipListCorrectness)
 {
-    SkipList sl;
+    SkipList<> sl;
     initSkipList(sl);
     ASSERT_EQ(sl.index.sum(), 51);
 
@@ -78,7 +88,7 @@ TEST_F(TDSLTest, SkipListCorrectness)
 
 TEST_F(TDSLTest, SkipListConcurrentInsert)
 {
-    SkipList sl;
+    SkipList<> sl;
     initSkipList(sl);
 
     SkipListTransaction trans1;
@@ -93,7 +103,7 @@ TEST_F(TDSLTest, SkipListConcurrentInsert)
 
 TEST_F(TDSLTest, SkipListConflictingInsert)
 {
-    SkipList sl;
+    SkipList<> sl;
     initSkipList(sl);
 
     {
@@ -133,7 +143,7 @@ TEST_F(TDSLTest, SkipListConflictingInsert)
 
 TEST_F(TDSLTest, SkipListConcurrentRemove)
 {
-    SkipList sl;
+    SkipList<> sl;
     ASSERT_NO_THROW(initSkipList(sl));
 
     SkipListTransaction trans1;
@@ -148,7 +158,7 @@ TEST_F(TDSLTest, SkipListConcurrentRemove)
 
 TEST_F(TDSLTest, SkipListConflictingRemove)
 {
-    SkipList sl;
+    SkipList<> sl;
     ASSERT_NO_THROW(initSkipList(sl));
 
     {
@@ -188,6 +198,1453 @@ TEST_F(TDSLTest, SkipListConflictingRemove)
 }
 
 
+TEST_F(TDSLTest, SkipListLockedNodeAborts)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    SkipList<>::NodeType * pred = sl.index.getPrev(5);
+    ASSERT_EQ(pred->key, 4);
+    ASSERT_TRUE(pred->lock.tryLock());
+    ASSERT_FALSE(pred->lock.tryLock());
+
+    {
+        SkipListTransaction trans;
+        sl.TXBegin(trans);
+        ASSERT_THROW(sl.contains(5, trans), AbortTransactionException);
+    }
+
+    pred->lock.unlock();
+
+    SkipListTransaction trans;
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.contains(5, trans));
+    ASSERT_TRUE(sl.contains(4, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+}
+
+
+TEST_F(TDSLTest, SkipListLargeWriteSet)
+{
+    SkipList<> sl;
+    SkipListTransaction trans;
+
+    // Enough operations to spill the write set out of its inline storage,
+    // and reuse the same transaction object afterwards.
+    sl.TXBegin(trans);
+    for (int i = 1; i <= 100; i++) {
+        ASSERT_TRUE(sl.insert(i, trans));
+    }
+    for (int i = 1; i <= 100; i += 2) {
+        ASSERT_TRUE(sl.remove(i, trans));
+    }
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.size(), 50);
+    ASSERT_EQ(sl.index.sum(), 2550);
+
+    sl.TXBegin(trans);
+    for (int i = 2; i <= 100; i += 2) {
+        ASSERT_TRUE(sl.contains(i, trans));
+        ASSERT_FALSE(sl.contains(i - 1, trans));
+    }
+    ASSERT_TRUE(sl.remove(100, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 2450);
+}
+
+
+TEST_F(TDSLTest, SkipListReadOnlyTransaction)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+    const VersionType version = sl.gvc.read();
+
+    {
+        SkipListTransaction trans;
+        sl.TXBegin(trans, TX_READ_ONLY);
+        ASSERT_TRUE(sl.contains(10, trans));
+        ASSERT_FALSE(sl.contains(11, trans));
+        ASSERT_TRUE(trans.readSet.empty());
+        ASSERT_THROW(sl.insert(11, trans), std::runtime_error);
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+    }
+
+    {
+        // A read-write transaction that ends up not writing is detected
+        SkipListTransaction trans;
+        sl.TXBegin(trans);
+        ASSERT_TRUE(sl.contains(15, trans));
+        ASSERT_FALSE(sl.remove(16, trans));
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+    }
+    ASSERT_EQ(sl.gvc.read(), version);
+
+    {
+        // Reads still abort when they observe a newer commit
+        SkipListTransaction trans1;
+        SkipListTransaction trans2;
+        sl.TXBegin(trans1, TX_READ_ONLY);
+        sl.TXBegin(trans2);
+        ASSERT_TRUE(sl.insert(12, trans2));
+        ASSERT_NO_THROW(sl.TXCommit(trans2));
+        ASSERT_THROW(sl.contains(13, trans1), AbortTransactionException);
+    }
+}
+
+
+TEST_F(TDSLTest, SkipListClockModes)
+{
+    const GVCMode modes[] = { GV1, GV4, GV5, GV6, GV_BATCHED };
+    for (GVCMode mode : modes) {
+        SkipList<> sl(mode);
+
+        // Lazy clocks (GV5 and friends) may abort a transaction once after
+        // an unpublished commit, but a retry must then go through.
+        auto runWithRetry = [&sl](std::function<void(SkipListTransaction &)> fn) {
+            SkipListTransaction trans;
+            for (int attempt = 0; attempt < 3; attempt++) {
+                try {
+                    sl.TXBegin(trans);
+                    fn(trans);
+                    sl.TXCommit(trans);
+                    return true;
+                } catch (AbortTransactionException &) {
+                }
+            }
+            return false;
+        };
+
+        for (int i = 1; i <= 20; i++) {
+            ASSERT_TRUE(runWithRetry([&sl, i](SkipListTransaction & trans) {
+                sl.insert(i, trans);
+            }));
+        }
+        ASSERT_EQ(sl.index.sum(), 210);
+
+        // Leave `trans` open with a pending insert next to key 26
+        SkipListTransaction trans;
+        ASSERT_TRUE(runWithRetry([&sl, &trans](SkipListTransaction &) {
+            sl.TXBegin(trans);
+            sl.insert(25, trans);
+        }));
+        ASSERT_TRUE(runWithRetry([&sl](SkipListTransaction & other) {
+            sl.insert(26, other);
+        }));
+        ASSERT_THROW(sl.TXCommit(trans), AbortTransactionException);
+        ASSERT_EQ(sl.index.sum(), 236);
+    }
+}
+
+
+TEST_F(TDSLTest, SkipListNoThrowApi)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    SkipListTransaction trans1;
+    SkipListTransaction trans2;
+    sl.TXBegin(trans1);
+    sl.TXBegin(trans2);
+    ASSERT_EQ(sl.tryInsert(11, trans1), OP_TRUE);
+    ASSERT_EQ(sl.tryInsert(10, trans1), OP_FALSE);
+    ASSERT_EQ(sl.tryContains(11, trans1), OP_TRUE);
+    ASSERT_EQ(sl.tryInsert(12, trans2), OP_TRUE);
+    ASSERT_TRUE(sl.TXTryCommit(trans1));
+    ASSERT_FALSE(trans1.aborted);
+
+    // Conflict during commit
+    ASSERT_FALSE(sl.TXTryCommit(trans2));
+    ASSERT_TRUE(trans2.aborted);
+    ASSERT_EQ(sl.index.sum(), 62);
+
+    // Conflict during an operation sticks to the transaction
+    sl.TXBegin(trans1);
+    sl.TXBegin(trans2);
+    ASSERT_EQ(sl.tryRemove(11, trans1), OP_TRUE);
+    ASSERT_TRUE(sl.TXTryCommit(trans1));
+    ASSERT_EQ(sl.tryRemove(10, trans2), OP_ABORTED);
+    ASSERT_EQ(sl.tryContains(0, trans2), OP_ABORTED);
+    ASSERT_FALSE(sl.TXTryCommit(trans2));
+    ASSERT_EQ(sl.index.sum(), 51);
+
+    // The transaction is usable again after TXBegin
+    sl.TXBegin(trans2);
+    ASSERT_FALSE(trans2.aborted);
+    ASSERT_EQ(sl.tryRemove(10, trans2), OP_TRUE);
+    ASSERT_TRUE(sl.TXTryCommit(trans2));
+    ASSERT_EQ(sl.index.sum(), 41);
+}
+
+
+TEST_F(TDSLTest, SkipListBackgroundIndexMaintenance)
+{
+    SkipList<> sl;
+    sl.index.startMaintenance(2);
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    SkipListTransaction trans;
+    for (int i = 30; i < 130; i++) {
+        sl.TXBegin(trans);
+        ASSERT_TRUE(sl.insert(i, trans));
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+    }
+    for (int i = 30; i < 130; i += 2) {
+        sl.TXBegin(trans);
+        ASSERT_TRUE(sl.remove(i, trans));
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+    }
+    ASSERT_EQ(sl.index.size(), 56);
+
+    sl.index.flush();
+    for (int i = 31; i < 130; i += 2) {
+        ASSERT_EQ(sl.index.getPrev(i + 1)->key, i);
+    }
+    sl.index.stopMaintenance();
+
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(129, trans));
+    ASSERT_FALSE(sl.contains(128, trans));
+    ASSERT_TRUE(sl.remove(129, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.getPrev(130)->key, 127);
+}
+
+
+TEST_F(TDSLTest, SkipListReclaimsRemovedNodes)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    SkipListTransaction trans;
+    for (int i = 100; i < 200; i++) {
+        sl.TXBegin(trans);
+        ASSERT_TRUE(sl.insert(i, trans));
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+    }
+
+    // A running transaction keeps everything retired after it began alive
+    SkipListTransaction reader;
+    sl.TXBegin(reader, TX_READ_ONLY);
+    for (int i = 100; i < 200; i++) {
+        sl.TXBegin(trans);
+        ASSERT_TRUE(sl.remove(i, trans));
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+    }
+    for (int i = 0; i < 3; i++) {
+        Epoch::collect();
+    }
+    ASSERT_GE(Epoch::pending(), 100u);
+
+    ASSERT_NO_THROW(sl.TXCommit(reader));
+    for (int i = 0; i < 3; i++) {
+        Epoch::collect();
+    }
+    ASSERT_EQ(Epoch::pending(), 0u);
+
+    // Nodes of an aborted insert are freed on the next TXBegin
+    SkipListTransaction other;
+    sl.TXBegin(trans);
+    sl.TXBegin(other);
+    ASSERT_TRUE(sl.insert(100, trans));
+    ASSERT_TRUE(sl.insert(101, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    ASSERT_THROW(sl.TXCommit(trans), AbortTransactionException);
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insert(100, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 252);
+}
+
+
+TEST_F(TDSLTest, SkipListSlabAllocator)
+{
+    // The class of the tallest inline towers, which nothing else shares
+    typedef NodeAllocator<ItemType, ItemType, NodeBase::MAX_INLINE_TOWER> Allocator;
+    ASSERT_EQ(cacheLineAligned(sizeof(SkipList<>::NodeType)) % CACHE_LINE_SIZE, 0u);
+    // Nodes carry no vtable pointer
+    ASSERT_FALSE(std::is_polymorphic<SkipList<>::NodeType>::value);
+
+    // Released blocks are handed out again, most recent first
+    void * first = Allocator::allocate();
+    void * second = Allocator::allocate();
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(first) % CACHE_LINE_SIZE, 0u);
+    ASSERT_NE(first, second);
+    Allocator::release(first);
+    Allocator::release(second);
+    ASSERT_EQ(Allocator::allocate(), second);
+    ASSERT_EQ(Allocator::allocate(), first);
+    Allocator::release(first);
+    Allocator::release(second);
+
+    // Blocks released by another thread are recycled through the depot
+    std::vector<void *> blocks;
+    std::thread producer([&blocks]()
+    {
+        for (int i = 0; i < 2048; i++) {
+            blocks.push_back(Allocator::allocate());
+        }
+    });
+    producer.join();
+    for (auto block : blocks) {
+        Allocator::release(block);
+    }
+
+    // Nodes and towers of aborted and removed inserts are recycled
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+    long size = sl.index.size();
+    SkipListTransaction trans;
+    for (int round = 0; round < 10; round++) {
+        sl.TXBegin(trans);
+        for (int i = 100; i < 200; i++) {
+            ASSERT_TRUE(sl.insert(i, trans));
+        }
+        sl.TXAbort(trans);
+
+        sl.TXBegin(trans);
+        for (int i = 100; i < 200; i++) {
+            ASSERT_TRUE(sl.insert(i, trans));
+        }
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+        sl.TXBegin(trans);
+        for (int i = 100; i < 200; i++) {
+            ASSERT_TRUE(sl.remove(i, trans));
+        }
+        ASSERT_NO_THROW(sl.TXCommit(trans));
+        Epoch::collect();
+    }
+    ASSERT_EQ(sl.index.sum(), 51);
+    ASSERT_EQ(sl.index.size(), size);
+}
+
+
+TEST_F(TDSLTest, SkipListGenericKeysAndValues)
+{
+    SkipList<int64_t, std::string> map;
+    SkipListTransaction trans;
+
+    // The head is a sentinel, so the smallest key is a regular key
+    const int64_t small = std::numeric_limits<int64_t>::min();
+    const int64_t large = std::numeric_limits<int64_t>::max();
+    map.TXBegin(trans);
+    ASSERT_TRUE(map.insert(small, "small", trans));
+    ASSERT_TRUE(map.insert(large, "large", trans));
+    ASSERT_TRUE(map.insert(1LL << 40, "big", trans));
+    ASSERT_FALSE(map.insert(small, "again", trans));
+    ASSERT_NO_THROW(map.TXCommit(trans));
+
+    std::string value;
+    map.TXBegin(trans, TX_READ_ONLY);
+    ASSERT_TRUE(map.get(small, value, trans));
+    ASSERT_EQ(value, "small");
+    ASSERT_TRUE(map.get(1LL << 40, value, trans));
+    ASSERT_EQ(value, "big");
+    ASSERT_FALSE(map.get(0, value, trans));
+    ASSERT_NO_THROW(map.TXCommit(trans));
+
+    map.TXBegin(trans);
+    ASSERT_TRUE(map.remove(small, trans));
+    ASSERT_NO_THROW(map.TXCommit(trans));
+    map.TXBegin(trans);
+    ASSERT_FALSE(map.contains(small, trans));
+    ASSERT_TRUE(map.get(large, value, trans));
+    ASSERT_EQ(value, "large");
+    ASSERT_NO_THROW(map.TXCommit(trans));
+
+    // The comparator decides the order of both the list and the index
+    SkipList<int, int, std::greater<int>> reversed;
+    reversed.TXBegin(trans);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(reversed.insert(i, -i, trans));
+    }
+    ASSERT_NO_THROW(reversed.TXCommit(trans));
+    ASSERT_EQ(reversed.index.getPrev(50)->key, 51);
+    ASSERT_TRUE(reversed.index.isHead(reversed.index.getPrev(100)));
+
+    int expected = 99;
+    for (auto n = reversed.index.getHead()->getNext(); n != NULL; n = n->getNext()) {
+        ASSERT_EQ(n->key, expected);
+        ASSERT_EQ(n->value, -expected);
+        expected--;
+    }
+    ASSERT_EQ(expected, -1);
+}
+
+
+TEST_F(TDSLTest, SkipListRangeScan)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    std::vector<int> keys;
+    auto collect = [&keys](const int & k, const int &) {
+        keys.push_back(k);
+    };
+
+    // Scans see the transaction's own inserts and removes
+    SkipListTransaction trans;
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insert(5, trans));
+    ASSERT_TRUE(sl.remove(10, trans));
+    ASSERT_TRUE(sl.scan(2, 15, collect, trans));
+    ASSERT_EQ(keys, std::vector<int>({2, 4, 5, 15}));
+    keys.clear();
+    ASSERT_FALSE(sl.scan(16, 19, collect, trans));
+    ASSERT_TRUE(keys.empty());
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+
+    sl.TXBegin(trans, TX_READ_ONLY);
+    auto it = sl.seek(3, trans);
+    for (; it.valid(); it.next()) {
+        keys.push_back(it.key());
+    }
+    ASSERT_EQ(keys, std::vector<int>({4, 5, 15, 20}));
+    ASSERT_THROW(it.next(), std::logic_error);
+    ASSERT_THROW(it.tryNext(), std::logic_error);
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+
+    // A failed step leaves the iterator past the end
+    SkipListTransaction writer;
+    sl.TXBegin(trans, TX_READ_ONLY);
+    it = sl.seek(15, trans);
+    sl.TXBegin(writer);
+    ASSERT_TRUE(sl.insert(16, writer));
+    ASSERT_NO_THROW(sl.TXCommit(writer));
+    ASSERT_FALSE(it.tryNext());
+    ASSERT_FALSE(it.valid());
+    ASSERT_THROW(it.tryNext(), std::logic_error);
+    sl.TXBegin(writer);
+    ASSERT_TRUE(sl.remove(16, writer));
+    ASSERT_NO_THROW(sl.TXCommit(writer));
+
+    // A key inserted into a scanned range aborts the scanning transaction
+    SkipListTransaction other;
+    keys.clear();
+    sl.TXBegin(trans);
+    sl.TXBegin(other);
+    ASSERT_TRUE(sl.scan(0, 10, collect, trans));
+    ASSERT_TRUE(sl.insert(100, trans));
+    ASSERT_TRUE(sl.remove(5, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    ASSERT_THROW(sl.TXCommit(trans), AbortTransactionException);
+
+    // Keys past the range do not conflict
+    sl.TXBegin(trans);
+    sl.TXBegin(other);
+    ASSERT_EQ(sl.tryScan(0, 4, collect, trans), OP_TRUE);
+    ASSERT_TRUE(sl.insert(100, trans));
+    ASSERT_TRUE(sl.insert(17, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+}
+
+
+TEST_F(TDSLTest, SkipListTraversalFinger)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    // Ascending operations continue from the previous pred
+    SkipListTransaction trans;
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insert(5, trans));
+    ASSERT_TRUE(sl.insert(6, trans));
+    ASSERT_EQ(static_cast<SkipList<>::NodeType *>(trans.finger)->key, 5);
+    ASSERT_TRUE(sl.insert(7, trans));
+    ASSERT_TRUE(sl.remove(10, trans));
+    ASSERT_TRUE(sl.contains(15, trans));
+    ASSERT_FALSE(sl.contains(10, trans));
+    ASSERT_TRUE(sl.contains(2, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 59);
+
+    // A finger locked by someone else is skipped rather than aborting
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.contains(3, trans));
+    SkipList<>::NodeType * finger = static_cast<SkipList<>::NodeType *>(trans.finger);
+    ASSERT_EQ(finger->key, 2);
+    ASSERT_TRUE(finger->lock.tryLock());
+    ASSERT_TRUE(sl.contains(20, trans));
+    finger->lock.unlock();
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+
+    // A finger from another list is ignored
+    SkipList<> other(sl.gvc);
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(15, trans));
+    ASSERT_FALSE(other.contains(16, trans));
+    ASSERT_EQ(trans.fingerList, &other);
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+}
+
+
+TEST_F(TDSLTest, SkipListBatchOperations)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    // A run of new keys between two nodes changes one pred entry
+    SkipListTransaction trans;
+    std::vector<int> run({5, 6, 7, 8});
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insertAll(run.begin(), run.end(), trans));
+    ASSERT_EQ(trans.writeSet.size(), 1u + run.size());
+    ASSERT_TRUE(sl.containsAll(run.begin(), run.end(), trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 77);
+    ASSERT_EQ(sl.index.getPrev(8)->key, 7);
+
+    // Existing and repeated keys are reported but do not stop the batch
+    std::vector<int> mixed({1, 1, 2, 3, 30, 31});
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.insertAll(mixed.begin(), mixed.end(), trans));
+    ASSERT_TRUE(sl.containsAll(mixed.begin(), mixed.end(), trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 142);
+
+    std::vector<int> gone({1, 3, 4, 5, 6, 40});
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.removeAll(gone.begin(), gone.end(), trans));
+    ASSERT_FALSE(sl.containsAll(gone.begin(), gone.end(), trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 123);
+
+    // Unsorted keys are merged correctly, just more slowly
+    std::vector<int> unsorted({50, 11, 49, 12});
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insertAll(unsorted.begin(), unsorted.end(), trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    sl.TXBegin(trans, TX_READ_ONLY);
+    std::vector<int> keys;
+    sl.scan(0, 100, [&keys](const int & k, const int &) {
+        keys.push_back(k);
+    }, trans);
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(keys, std::vector<int>({0, 2, 7, 8, 10, 11, 12, 15, 20, 30, 31, 49, 50}));
+
+    // A concurrent change to the merged range aborts the batch
+    SkipListTransaction other;
+    std::vector<int> batch({13, 14});
+    sl.TXBegin(trans);
+    sl.TXBegin(other);
+    ASSERT_TRUE(sl.insertAll(batch.begin(), batch.end(), trans));
+    ASSERT_TRUE(sl.remove(12, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    ASSERT_THROW(sl.TXCommit(trans), AbortTransactionException);
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.containsAll(batch.begin(), batch.end(), trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+
+    // Inserted keys carry the commit's version, so a snapshot that missed
+    // them aborts when it runs into them
+    std::vector<int> late({16, 17, 18});
+    sl.TXBegin(other, TX_READ_ONLY);
+    ASSERT_FALSE(sl.contains(17, other));
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insertAll(late.begin(), late.end(), trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_THROW(sl.contains(17, other), AbortTransactionException);
+}
+
+
+TEST_F(TDSLTest, SkipListWriteSetFilter)
+{
+    std::vector<SkipList<>::NodeType *> nodes;
+    for (int i = 0; i < 64; i++) {
+        nodes.push_back(SkipList<>::NodeType::create(i, i, 0));
+    }
+
+    WriteSet::resetFilterStats();
+    {
+        WriteSet writeSet;
+        for (int i = 0; i < 4; i++) {
+            writeSet.addItem(nodes[i], nodes[i + 1], false);
+        }
+
+        NodeBase * next = NULL;
+        for (int i = 0; i < 64; i++) {
+            ASSERT_EQ(writeSet.getValue(nodes[i], next), i < 4);
+            ASSERT_EQ(writeSet.contains(nodes[i]), i < 4);
+        }
+        ASSERT_EQ(next, nodes[4]);
+
+        // Cleared write sets start with an empty filter, and their counts
+        // reach the totals right away
+        writeSet.clear();
+        ASSERT_EQ(WriteSet::totalFilterStats().lookups, 128u);
+        ASSERT_FALSE(writeSet.contains(nodes[0]));
+    }
+
+    // The rest is flushed when the write set is destroyed
+    FilterStats stats = WriteSet::totalFilterStats();
+    ASSERT_EQ(stats.lookups, 129u);
+    ASSERT_EQ(stats.lookups, 8 + stats.filtered + stats.falsePositives);
+    ASSERT_GT(stats.filtered, 100u);
+
+    for (auto node : nodes) {
+        node->destroy();
+    }
+
+    // A transaction object that lives on reports every transaction it ran
+    SkipList<> sl;
+    SkipListTransaction trans;
+    WriteSet::resetFilterStats();
+    sl.TXBegin(trans);
+    for (int i = 0; i < 8; i++) {
+        ASSERT_TRUE(sl.insert(i, trans));
+    }
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    const uint64_t first = WriteSet::totalFilterStats().lookups;
+    ASSERT_GT(first, 0u);
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(3, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_GT(WriteSet::totalFilterStats().lookups, first);
+
+    // Resetting leaves the counters of running threads alone: what they
+    // flush afterwards is neither lost nor joined by what came before
+    std::atomic<bool> flushed(false), reset(false);
+    std::thread counter([&]() {
+        WriteSet writeSet;
+        writeSet.contains(sl.index.getPrev(0));
+        writeSet.flushFilterStats();
+        flushed = true;
+        while (!reset) {
+            std::this_thread::yield();
+        }
+        writeSet.contains(sl.index.getPrev(0));
+    });
+    while (!flushed) {
+        std::this_thread::yield();
+    }
+    WriteSet::resetFilterStats();
+    reset = true;
+    counter.join();
+    ASSERT_EQ(WriteSet::totalFilterStats().lookups, 1u);
+}
+
+
+TEST_F(TDSLTest, SkipListMultiStructureTransaction)
+{
+    GVC clock;
+    SkipList<> from(clock), to(clock);
+    ASSERT_NO_THROW(initSkipList(from));
+
+    // Moving a key between lists commits once, with one version
+    Transaction trans;
+    trans.begin(clock);
+    ASSERT_TRUE(from.remove(10, trans));
+    ASSERT_TRUE(to.insert(10, trans));
+    const VersionType version = clock.read();
+    ASSERT_NO_THROW(trans.commit());
+    ASSERT_EQ(clock.read(), version + 1);
+    ASSERT_EQ(from.index.sum(), 41);
+    ASSERT_EQ(to.index.sum(), 10);
+
+    // A conflict on either list aborts the whole transaction
+    Transaction other;
+    trans.begin(clock);
+    other.begin(clock);
+    ASSERT_TRUE(from.remove(15, trans));
+    ASSERT_TRUE(to.insert(15, trans));
+    ASSERT_TRUE(to.insert(11, other));
+    ASSERT_NO_THROW(other.commit());
+    ASSERT_THROW(trans.commit(), AbortTransactionException);
+
+    trans.begin(clock, TX_READ_ONLY);
+    ASSERT_TRUE(from.contains(15, trans));
+    ASSERT_FALSE(to.contains(15, trans));
+    ASSERT_TRUE(to.contains(11, trans));
+    ASSERT_NO_THROW(trans.commit());
+    ASSERT_EQ(to.index.sum(), 21);
+
+    // Lists on another clock cannot join
+    SkipList<> separate;
+    trans.begin(clock);
+    ASSERT_THROW(separate.contains(1, trans), std::runtime_error);
+    trans.abort();
+}
+
+
+TEST_F(TDSLTest, SkipListAtomically)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    // Aborted attempts are rerun and counted
+    int attempts = 0;
+    unsigned int retries = sl.atomically([&](SkipListTransaction & trans) {
+        sl.insert(100 + attempts, trans);
+        if (++attempts < 3) {
+            throw AbortTransactionException();
+        }
+    }, RetryPolicy(CM_IMMEDIATE));
+    ASSERT_EQ(retries, 2u);
+    ASSERT_EQ(sl.index.sum(), 51 + 102);
+
+    // Giving up once the abort budget is spent
+    SkipList<>::NodeType * pred = sl.index.getPrev(5);
+    ASSERT_TRUE(pred->lock.tryLock());
+    attempts = 0;
+    ASSERT_THROW(sl.atomically([&](SkipListTransaction & trans) {
+        attempts++;
+        sl.tryContains(5, trans);
+    }, RetryPolicy(CM_BACKOFF, 4)), AbortTransactionException);
+    ASSERT_EQ(attempts, 4);
+    pred->lock.unlock();
+
+    // Other exceptions abort the transaction and propagate
+    ASSERT_THROW(sl.atomically([&](SkipListTransaction & trans) {
+        sl.insert(7, trans);
+        throw std::logic_error("failed");
+    }), std::logic_error);
+
+    // Contended updates all commit under every policy
+    const ContentionPolicy policies[] = {CM_IMMEDIATE, CM_BACKOFF, CM_KARMA};
+    for (auto policy : policies) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.push_back(std::thread([&sl, t, policy]() {
+                for (int i = 0; i < 100; i++) {
+                    const int key = 1000 + t * 100 + i;
+                    sl.atomically([&](SkipListTransaction & trans) {
+                        if (!sl.remove(key, trans)) {
+                            sl.insert(key, trans);
+                        }
+                        if (!sl.remove(7, trans)) {
+                            sl.insert(7, trans);
+                        }
+                    }, RetryPolicy(policy));
+                }
+            }));
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Every key was toggled three times; 7 an even number of times
+    SkipListTransaction trans;
+    sl.TXBegin(trans, TX_READ_ONLY);
+    ASSERT_FALSE(sl.contains(7, trans));
+    std::vector<int> keys;
+    ASSERT_TRUE(sl.scan(1000, 1399, [&keys](const int & k, const int &) {
+        keys.push_back(k);
+    }, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(keys.size(), 400u);
+}
+
+
+TEST_F(TDSLTest, SkipListIrrevocable)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    // Other commits wait until the irrevocable transaction is done
+    SkipListTransaction trans;
+    sl.TXBegin(trans, TX_IRREVOCABLE);
+    ASSERT_FALSE(sl.contains(100, trans));
+    std::atomic<bool> committed(false);
+    std::thread writer([&sl, &committed]() {
+        sl.atomically([&](SkipListTransaction & other) {
+            sl.insert(101, other);
+        });
+        committed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(committed.load());
+    ASSERT_TRUE(sl.insert(100, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    writer.join();
+    ASSERT_EQ(sl.index.sum(), 51 + 100 + 101);
+
+    // The token holder's own thread still commits, but cannot take the
+    // token twice
+    sl.TXBegin(trans, TX_IRREVOCABLE);
+    ASSERT_TRUE(sl.singletonInsert(102));
+    SkipListTransaction other;
+    sl.TXBegin(other);
+    ASSERT_TRUE(sl.remove(102, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    SkipListTransaction second;
+    ASSERT_THROW(sl.TXBegin(second, TX_IRREVOCABLE), std::runtime_error);
+    ASSERT_FALSE(second.active);
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 51 + 100 + 101);
+
+    // atomically() switches to irrevocable mode after irrevocableAfter aborts
+    std::vector<TransactionType> types;
+    unsigned int retries = sl.atomically([&](SkipListTransaction & other) {
+        types.push_back(other.type);
+        if (other.type != TX_IRREVOCABLE) {
+            throw AbortTransactionException();
+        }
+        sl.remove(100, other);
+    }, RetryPolicy(CM_IMMEDIATE, 0, 2));
+    ASSERT_EQ(retries, 2u);
+    ASSERT_EQ(types.size(), 3u);
+    ASSERT_EQ(types[0], TX_READ_WRITE);
+    ASSERT_EQ(types[2], TX_IRREVOCABLE);
+    ASSERT_EQ(sl.index.sum(), 51 + 101);
+
+    // Contended irrevocable transactions run one at a time
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&sl, t]() {
+            for (int i = 0; i < 50; i++) {
+                sl.atomically([&](SkipListTransaction & other) {
+                    sl.insert(1000 + t * 100 + i, other);
+                    if (!sl.remove(7, other)) {
+                        sl.insert(7, other);
+                    }
+                }, RetryPolicy(CM_IMMEDIATE, 0, 1));
+            }
+        }));
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(sl.index.size(), 7 + 200);
+}
+
+
+TEST_F(TDSLTest, SkipListNestedTransactions)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+
+    // A child undone on its own leaves the parent's writes in place, even
+    // those the child overwrote
+    SkipListTransaction trans;
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insert(5, trans));
+    sl.TXBeginNested(trans);
+    ASSERT_TRUE(sl.remove(5, trans));
+    for (int i = 0; i < 30; i++) {
+        ASSERT_TRUE(sl.insert(100 + i, trans));
+    }
+    ASSERT_EQ(trans.nestingDepth(), 1u);
+    ASSERT_TRUE(sl.TXAbortNested(trans));
+    ASSERT_EQ(trans.nestingDepth(), 0u);
+    ASSERT_TRUE(sl.contains(5, trans));
+    ASSERT_FALSE(sl.contains(100, trans));
+
+    // Ending a child that is not open is an error
+    ASSERT_THROW(sl.TXCommitNested(trans), std::logic_error);
+    ASSERT_THROW(sl.TXAbortNested(trans), std::logic_error);
+    ASSERT_FALSE(trans.aborted);
+
+    // A committed child joins the parent
+    sl.TXBeginNested(trans);
+    ASSERT_TRUE(sl.insert(6, trans));
+    ASSERT_NO_THROW(sl.TXCommitNested(trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 51 + 5 + 6);
+
+    // A conflict in the child only retries the child, which then sees the
+    // conflicting commit
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(5, trans));
+    SkipListTransaction other;
+    sl.TXBegin(other);
+    ASSERT_TRUE(sl.insert(17, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    sl.TXBeginNested(trans);
+    ASSERT_THROW(sl.contains(17, trans), AbortTransactionException);
+    ASSERT_THROW(sl.TXCommitNested(trans), AbortTransactionException);
+    ASSERT_FALSE(trans.aborted);
+    sl.TXBeginNested(trans);
+    ASSERT_TRUE(sl.contains(17, trans));
+    ASSERT_TRUE(sl.remove(17, trans));
+    ASSERT_NO_THROW(sl.TXCommitNested(trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_EQ(sl.index.sum(), 51 + 5 + 6);
+
+    // Once the parent's reads changed the whole transaction aborts
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(5, trans));
+    sl.TXBegin(other);
+    ASSERT_TRUE(sl.remove(5, other));
+    ASSERT_TRUE(sl.insert(17, other));
+    ASSERT_NO_THROW(sl.TXCommit(other));
+    sl.TXBeginNested(trans);
+    ASSERT_EQ(sl.tryContains(17, trans), OP_ABORTED);
+    ASSERT_FALSE(sl.TXAbortNested(trans));
+    ASSERT_TRUE(trans.aborted);
+    ASSERT_THROW(sl.TXTryCommitNested(trans), std::logic_error);
+    ASSERT_FALSE(sl.TXTryCommit(trans));
+
+    // atomicallyNested() retries the child and, once the parent is invalid,
+    // atomically() the whole transaction
+    int parents = 0;
+    int children = 0;
+    sl.atomically([&](SkipListTransaction & t) {
+        parents++;
+        sl.contains(4, t);
+        atomicallyNested(t, [&](SkipListTransaction & child) {
+            children++;
+            if (children == 1) {
+                throw AbortTransactionException();
+            }
+            sl.insert(200, child);
+        });
+    });
+    ASSERT_EQ(parents, 1);
+    ASSERT_EQ(children, 2);
+    ASSERT_EQ(sl.index.sum(), 51 + 6 + 17 + 200);
+}
+
+
+TEST_F(TDSLTest, SkipListSingletonOperations)
+{
+    SkipList<int, int> sl;
+    ASSERT_TRUE(sl.singletonInsert(5, 50));
+    ASSERT_FALSE(sl.singletonInsert(5, 51));
+    ASSERT_TRUE(sl.singletonContains(5));
+    ASSERT_FALSE(sl.singletonContains(6));
+    int v = 0;
+    ASSERT_TRUE(sl.singletonGet(5, v));
+    ASSERT_EQ(v, 50);
+
+    // Transactions see singleton updates, and conflict with them
+    SkipListTransaction trans;
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(5, trans));
+    ASSERT_TRUE(sl.singletonRemove(5));
+    ASSERT_FALSE(sl.singletonRemove(5));
+    ASSERT_THROW(sl.insert(7, trans), AbortTransactionException);
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.contains(5, trans));
+    ASSERT_TRUE(sl.insert(7, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    ASSERT_TRUE(sl.singletonContains(7));
+
+    // Singleton updates mixed with transactions on the same keys
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&sl, t]() {
+            for (int i = 0; i < 200; i++) {
+                const int key = 1000 + t * 1000 + i;
+                if (t % 2 == 0) {
+                    ASSERT_TRUE(sl.singletonInsert(key, key));
+                    ASSERT_TRUE(sl.singletonInsert(7000 + key, key));
+                    ASSERT_TRUE(sl.singletonRemove(7000 + key));
+                } else {
+                    sl.atomically([&](SkipListTransaction & other) {
+                        sl.insert(key, key, other);
+                        if (!sl.remove(7, other)) {
+                            sl.insert(7, other);
+                        }
+                    });
+                }
+                ASSERT_TRUE(sl.singletonContains(key));
+            }
+        }));
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(sl.index.size(), 1 + 800);
+    ASSERT_TRUE(sl.singletonContains(7));
+}
+
+
+TEST_F(TDSLTest, SkipListAbortStats)
+{
+    SkipList<> sl;
+    ASSERT_NO_THROW(initSkipList(sl));
+    SkipList<>::resetAbortStats();
+
+    // A read of a locked node
+    SkipListTransaction trans;
+    SkipList<>::NodeType * pred = sl.index.getPrev(5);
+    ASSERT_TRUE(pred->lock.tryLock());
+    sl.TXBegin(trans);
+    ASSERT_EQ(sl.tryContains(5, trans), OP_ABORTED);
+    pred->lock.unlock();
+    ASSERT_FALSE(sl.TXTryCommit(trans));
+
+    // A read of a newer version
+    sl.TXBegin(trans);
+    ASSERT_FALSE(sl.contains(5, trans));
+    ASSERT_TRUE(sl.singletonInsert(16));
+    ASSERT_EQ(sl.tryContains(17, trans), OP_ABORTED);
+    ASSERT_FALSE(sl.TXTryCommit(trans));
+
+    // A read set that changed before the commit
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insert(3, trans));
+    ASSERT_TRUE(sl.singletonRemove(4));
+    ASSERT_FALSE(sl.TXTryCommit(trans));
+
+    // A write set node locked at commit
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.insert(7, trans));
+    pred = sl.index.getPrev(7);
+    ASSERT_TRUE(pred->lock.tryLock());
+    ASSERT_FALSE(sl.TXTryCommit(trans));
+    pred->lock.unlock();
+
+    // An abort by the application, and one after a conflict, which is not
+    // counted again
+    sl.TXBegin(trans);
+    ASSERT_TRUE(sl.contains(10, trans));
+    sl.TXAbort(trans);
+    sl.TXAbort(trans);
+
+    AbortStats stats = SkipList<>::abortStats();
+    ASSERT_EQ(stats.counts[ABORT_LOCKED], 1u);
+    ASSERT_EQ(stats.counts[ABORT_NEWER_VERSION], 1u);
+    ASSERT_EQ(stats.counts[ABORT_VALIDATION], 1u);
+    ASSERT_EQ(stats.counts[ABORT_COMMIT_LOCK], 1u);
+    ASSERT_EQ(stats.counts[ABORT_EXPLICIT], 1u);
+    ASSERT_EQ(stats.total(), 5u);
+
+    // Counts of other threads add up, also once they exited
+    std::thread other([&sl]() {
+        SkipListTransaction t;
+        sl.TXBegin(t);
+        sl.TXAbort(t);
+    });
+    other.join();
+    ASSERT_EQ(SkipList<>::abortStats().counts[ABORT_EXPLICIT], 2u);
+    SkipList<>::resetAbortStats();
+    ASSERT_EQ(SkipList<>::abortStats().total(), 0u);
+
+    // A reset while another thread counts only restarts the totals
+    std::atomic<bool> counted(false), reset(false);
+    std::thread counter([&]() {
+        AbortStats::record(ABORT_LOCKED);
+        counted = true;
+        while (!reset) {
+            std::this_thread::yield();
+        }
+        AbortStats::record(ABORT_LOCKED);
+    });
+    while (!counted) {
+        std::this_thread::yield();
+    }
+    SkipList<>::resetAbortStats();
+    reset = true;
+    counter.join();
+    ASSERT_EQ(SkipList<>::abortStats().counts[ABORT_LOCKED], 1u);
+    ASSERT_EQ(SkipList<>::abortStats().total(), 1u);
+}
+
+
+TEST_F(TDSLTest, SkipListIndexConfig)
+{
+    SkipList<> defaults;
+    ASSERT_EQ(defaults.index.getConfig().fanout, 4u);
+    ASSERT_EQ(defaults.index.getConfig().maxLayer, 12u);
+    ASSERT_EQ(defaults.index.getConfig().layerLimit, (size_t)SKIPLIST_DEFAULT_LAYER_LIMIT);
+
+    // A small index grows a layer whenever its size reaches fanout^layers
+    skiplist_raw_config config = skiplist_get_default_config();
+    config.fanout = 2;
+    config.maxLayer = 3;
+    config.layerLimit = 6;
+    SkipList<> sl(GV1, config);
+    ASSERT_EQ(sl.index.getConfig().maxLayer, 3u);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&sl, t]() {
+            for (int i = 0; i < 25; i++) {
+                ASSERT_TRUE(sl.singletonInsert(t * 25 + i));
+            }
+        }));
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+#ifndef TDSL_BTREE_INDEX
+    // A B+-tree has no layers to grow
+    ASSERT_EQ(sl.index.getConfig().maxLayer, 6u);
+#endif
+    ASSERT_EQ(sl.index.size(), 100);
+    for (int k = 0; k < 100; k++) {
+        ASSERT_TRUE(sl.singletonContains(k));
+    }
+}
+
+
+TEST_F(TDSLTest, SkipListOptimisticIndexLookup)
+{
+    SkipList<> sl;
+    for (int k = 0; k < 1000; k += 2) {
+        ASSERT_TRUE(sl.singletonInsert(k));
+    }
+
+    // Lookups stay correct while writers link and unlink odd keys
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; t++) {
+        writers.push_back(std::thread([&sl, &stop, t]() {
+            while (!stop.load()) {
+                for (int k = 1 + t * 500; k < 500 + t * 500; k += 2) {
+                    sl.singletonInsert(k);
+                }
+                for (int k = 1 + t * 500; k < 500 + t * 500; k += 2) {
+                    sl.singletonRemove(k);
+                }
+            }
+        }));
+    }
+    for (int round = 0; round < 20; round++) {
+        EpochGuard guard;
+        for (int k = 2; k < 1000; k += 2) {
+            SkipList<>::NodeType * prev = sl.index.getPrev(k);
+            ASSERT_FALSE(sl.index.isHead(prev));
+            ASSERT_LT(prev->key, k);
+            ASSERT_GE(prev->key, k - 2);
+        }
+        ASSERT_TRUE(sl.index.isHead(sl.index.getPrev(0)));
+    }
+    stop = true;
+    for (auto & writer : writers) {
+        writer.join();
+    }
+}
+
+
+TEST_F(TDSLTest, SkipListInlineTowers)
+{
+    // A node's index tower sits right behind it, sized by its top layer
+    SkipList<>::NodeType * node = SkipList<>::NodeType::create(1, 1, 0, 2);
+    ASSERT_TRUE(node->snode.fixed_tower);
+    ASSERT_EQ(node->snode.top_layer, 2);
+    ASSERT_EQ(reinterpret_cast<void *>(node->snode.next), reinterpret_cast<void *>(node + 1));
+    node->destroy();
+
+    // Taller towers, and nodes created without a layer, get theirs on insert
+    node = SkipList<>::NodeType::create(1, 1, 0, NodeBase::MAX_INLINE_TOWER);
+    ASSERT_FALSE(node->snode.fixed_tower);
+    node->destroy();
+    node = SkipList<>::NodeType::create(1, 1, 0);
+    ASSERT_FALSE(node->snode.fixed_tower);
+    node->destroy();
+
+    // Backends that keep their own entries want no tower at all
+    ASSERT_EQ((Index<int, int, std::less<int>, KeySkipListBackend<int, int>>(0).chooseTopLayer()),
+              NodeBase::NO_TOWER);
+    ASSERT_EQ((Index<int, int, std::less<int>, BTreeBackend<int, int>>(0).chooseTopLayer()),
+              NodeBase::NO_TOWER);
+
+    SkipList<> list;
+    SkipListTransaction trans;
+    list.TXBegin(trans);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(list.insert(i, i, trans));
+    }
+    ASSERT_NO_THROW(list.TXCommit(trans));
+    ASSERT_EQ(list.index.size(), 1000);
+
+    // Lookups go through the index, whose towers are all inline
+    list.TXBegin(trans);
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(list.remove(i, trans));
+    }
+    ASSERT_NO_THROW(list.TXCommit(trans));
+    list.TXBegin(trans, TX_READ_ONLY);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(list.contains(i, trans), i % 2 == 1);
+    }
+    ASSERT_NO_THROW(list.TXCommit(trans));
+    ASSERT_EQ(list.index.size(), 500);
+}
+
+// Every index backend, over the same workload
+template <typename Backend>
+class IndexBackendTest : public ::testing::Test
+{
+};
+
+typedef ::testing::Types<RawSkipListBackend<int, int>,
+        RawSkipListBackend<int, int, std::less<int>, true>,
+        KeySkipListBackend<int, int>, BTreeBackend<int, int>> IndexBackends;
+TYPED_TEST_CASE(IndexBackendTest, IndexBackends);
+
+TYPED_TEST(IndexBackendTest, DuplicateKeys)
+{
+    typedef SkipList<>::NodeType NodeType;
+    NodeType head(0, 0, 0);
+    TypeParam backend(&head, skiplist_get_default_config());
+
+    // Every thread indexes its own nodes, under the same keys, and erases
+    // half of them
+    const int numThreads = 4;
+    const int numKeys = 5000;
+    std::vector<std::vector<NodeType *>> nodes(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.push_back(std::thread([&backend, &nodes, t]()
+        {
+            EpochGuard guard;
+            for (int i = 0; i < numKeys; i++) {
+                nodes[t].push_back(NodeType::create(i, t, 0, backend.chooseTopLayer()));
+                backend.insert(nodes[t][i]);
+            }
+            for (int i = t % 2; i < numKeys; i += 2) {
+                backend.erase(nodes[t][i]);
+            }
+        }));
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    EpochGuard guard;
+    for (int i = 0; i < numKeys; i++) {
+        // Odd keys survived in even threads and vice versa
+        NodeType * prev = backend.findSmaller(i + 1);
+        ASSERT_TRUE(prev != NULL);
+        ASSERT_EQ(prev->key, i);
+        ASSERT_EQ(prev->value % 2, 1 - i % 2);
+    }
+    ASSERT_TRUE(backend.findSmaller(0) == NULL);
+
+    for (auto & list : nodes) {
+        for (auto node : list) {
+            node->destroy();
+        }
+    }
+}
+
+static int compareTestNodes(skiplist_node * a, skiplist_node * b, void *)
+{
+    const int aa = SkipList<>::NodeType::fromIndex(a)->key;
+    const int bb = SkipList<>::NodeType::fromIndex(b)->key;
+    return aa < bb ? -1 : (aa > bb ? 1 : 0);
+}
+
+TEST_F(TDSLTest, SkipListLockFreeIndex)
+{
+    skiplist_raw sl;
+    skiplist_init(&sl, compareTestNodes);
+
+    // Two threads insert the even keys while two others keep inserting and
+    // erasing the odd keys between them, so that inserts and erases keep
+    // landing next to each other
+    const int numKeys = 2000;
+    const int rounds = 4;
+    std::vector<std::vector<SkipList<>::NodeType *>> nodes(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&sl, &nodes, t]()
+        {
+            for (int r = 0; r < (t < 2 ? 1 : rounds); r++) {
+                for (int i = t % 2; i < numKeys; i += 2) {
+                    const int key = t < 2 ? 2 * i : 2 * i + 1;
+                    SkipList<>::NodeType * node = SkipList<>::NodeType::create(
+                                                      key, t, 0, skiplist_choose_top_layer(&sl));
+                    nodes[t].push_back(node);
+                    ASSERT_EQ(skiplist_lf_insert(&sl, &node->snode), 0);
+                    if (t >= 2) {
+                        ASSERT_EQ(skiplist_lf_erase_node(&sl, &node->snode), 0);
+                    }
+                }
+            }
+        }));
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(skiplist_get_size(&sl), (size_t)numKeys);
+    SkipList<>::NodeType query(0, 0, 0);
+    for (int i = 0; i < numKeys; i++) {
+        query.key = 2 * i + 1;
+        skiplist_node * prev = skiplist_lf_find_smaller(&sl, &query.snode);
+        ASSERT_TRUE(prev != NULL);
+        ASSERT_EQ(SkipList<>::NodeType::fromIndex(prev)->key, 2 * i);
+        query.key = 2 * i + 2;
+        prev = skiplist_lf_find_smaller(&sl, &query.snode);
+        ASSERT_EQ(SkipList<>::NodeType::fromIndex(prev)->key, 2 * i);
+    }
+    query.key = 0;
+    ASSERT_TRUE(skiplist_lf_find_smaller(&sl, &query.snode) == NULL);
+
+    // Erasing twice, or a node never inserted, fails
+    ASSERT_EQ(skiplist_lf_erase_node(&sl, &nodes[2][0]->snode), -1);
+    ASSERT_EQ(skiplist_lf_erase_node(&sl, &query.snode), -1);
+
+    for (auto & list : nodes) {
+        for (auto node : list) {
+            node->destroy();
+        }
+    }
+    skiplist_free(&sl);
+}
+
+TEST_F(TDSLTest, SkipListKeyIndex)
+{
+    // A small list grows a layer whenever its size reaches fanout^layers,
+    // up to layerLimit, however many threads insert
+    skiplist_raw_config config = skiplist_get_default_config();
+    config.fanout = 2;
+    config.maxLayer = 2;
+    config.layerLimit = 6;
+    KeySkipList<int> keys(config);
+    ASSERT_EQ(keys.getConfig().maxLayer, 2u);
+
+    const int numKeys = 100;
+    std::vector<SkipList<>::NodeType *> nodes;
+    for (int i = 0; i < numKeys; i++) {
+        nodes.push_back(SkipList<>::NodeType::create(i, i, 0));
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&keys, &nodes, t]()
+        {
+            EpochGuard guard;
+            for (int i = t; i < numKeys; i += 4) {
+                keys.insert(i, nodes[i]);
+            }
+        }));
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(keys.size(), (size_t)numKeys);
+    ASSERT_EQ(keys.getConfig().maxLayer, 6u);
+    ASSERT_EQ(keys.getConfig().layerLimit, 6u);
+
+    // Searches start from the new layers and still find every entry
+    EpochGuard guard;
+    for (int i = 0; i < numKeys; i++) {
+        ASSERT_EQ(static_cast<SkipList<>::NodeType *>(keys.findSmaller(i + 1))->key, i);
+    }
+
+    // Erasing does not shrink the list again
+    for (int i = 0; i < numKeys; i += 2) {
+        ASSERT_TRUE(keys.erase(i, nodes[i]));
+    }
+    ASSERT_FALSE(keys.erase(0, nodes[0]));
+    ASSERT_EQ(keys.getConfig().maxLayer, 6u);
+    ASSERT_EQ(static_cast<SkipList<>::NodeType *>(keys.findSmaller(numKeys))->key, numKeys - 1);
+    ASSERT_TRUE(keys.findSmaller(1) == NULL);
+
+    for (auto node : nodes) {
+        node->destroy();
+    }
+}
+
+TEST_F(TDSLTest, SkipListBTreeIndex)
+{
+    typedef SkipList<>::NodeType NodeType;
+    const int numKeys = 100000;
+    const int window = 1000;
+    std::vector<NodeType *> nodes;
+    for (int i = 0; i < numKeys; i++) {
+        nodes.push_back(NodeType::create(i, i, 0));
+    }
+
+    {
+        // A sliding window leaves emptied leaves behind on one side; they
+        // are reclaimed, and lookups just past them stay cheap
+        OLCBTree<int> tree;
+        EpochGuard guard;
+        for (int i = 0; i < numKeys; i++) {
+            tree.insert(i, nodes[i]);
+            if (i >= window) {
+                ASSERT_TRUE(tree.erase(i - window, nodes[i - window]));
+            }
+        }
+        ASSERT_EQ(tree.size(), (size_t)window);
+        ASSERT_LT(tree.pages(), (size_t)(2 * window / 40));
+        const int first = numKeys - window;
+        ASSERT_TRUE(tree.findSmaller(first) == NULL);
+        ASSERT_EQ(static_cast<NodeType *>(tree.findSmaller(first + 1))->key, first);
+        ASSERT_EQ(static_cast<NodeType *>(tree.findSmaller(numKeys))->key, numKeys - 1);
+
+        // Erasing everything leaves a single empty leaf
+        for (int i = first; i < numKeys; i++) {
+            ASSERT_TRUE(tree.erase(i, nodes[i]));
+        }
+        ASSERT_EQ(tree.size(), 0u);
+        ASSERT_EQ(tree.pages(), 1u);
+        ASSERT_EQ(tree.height(), 1u);
+        ASSERT_TRUE(tree.findSmaller(numKeys) == NULL);
+    }
+
+    {
+        // Two threads slide windows over interleaved keys while two others
+        // look up keys in the region being emptied
+        OLCBTree<int> tree;
+        std::atomic<int> writers(2);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; t++) {
+            threads.push_back(std::thread([&tree, &nodes, &writers, t]()
+            {
+                for (int i = t; i < numKeys; i += 2) {
+                    EpochGuard guard;
+                    tree.insert(i, nodes[i]);
+                    if (i >= window) {
+                        ASSERT_TRUE(tree.erase(i - window, nodes[i - window]));
+                    }
+                }
+                writers--;
+            }));
+        }
+        for (int t = 0; t < 2; t++) {
+            threads.push_back(std::thread([&tree, &writers, t]()
+            {
+                std::minstd_rand random(t);
+                while (writers.load() != 0) {
+                    EpochGuard guard;
+                    const int k = random() % numKeys;
+                    NodeBase * prev = tree.findSmaller(k);
+                    ASSERT_TRUE(prev == NULL || static_cast<NodeType *>(prev)->key < k);
+                }
+            }));
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+
+        EpochGuard guard;
+        ASSERT_EQ(tree.size(), (size_t)window);
+        ASSERT_LT(tree.pages(), (size_t)(2 * window / 40));
+        for (int i = numKeys - window; i < numKeys; i++) {
+            ASSERT_EQ(static_cast<NodeType *>(tree.findSmaller(i + 1))->key, i);
+        }
+        ASSERT_TRUE(tree.findSmaller(numKeys - window) == NULL);
+    }
+
+    for (auto node : nodes) {
+        node->destroy();
+    }
+
+    // The backend is a template parameter of the SkipList
+    SkipList<int, int, std::less<int>, BTreeBackend<int, int>> sl;
+    SkipListTransaction trans;
+    sl.TXBegin(trans);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(sl.insert(2 * i, i, trans));
+    }
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+    sl.TXBegin(trans);
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(sl.remove(2 * i, trans));
+    }
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+
+    EpochGuard guard;
+    ASSERT_TRUE(sl.index.isHead(sl.index.getPrev(0)));
+    ASSERT_EQ(sl.index.getPrev(5)->key, 2);
+    ASSERT_EQ(sl.index.getPrev(8)->key, 6);
+    ASSERT_EQ(sl.index.getPrev(5000)->key, 1998);
+    ASSERT_EQ(sl.index.size(), 500);
+    sl.TXBegin(trans);
+    int value;
+    ASSERT_TRUE(sl.get(6, value, trans));
+    ASSERT_EQ(value, 3);
+    ASSERT_FALSE(sl.contains(4, trans));
+    ASSERT_NO_THROW(sl.TXCommit(trans));
+}
+
 int main(int argc, char ** argv)
 {
     testing::InitGoogleTest(&argc, argv);
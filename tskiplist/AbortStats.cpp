@@ -0,0 +1,85 @@
+#include "AbortStats.h"
+
+class AbortRecord
+{
+public:
+    AbortRecord()
+    {
+        for (auto & count : counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Only ever grow, and only the owning thread writes them, so plain loads
+    // and stores suffice.
+    std::atomic<uint64_t> counts[NUM_ABORT_CAUSES];
+};
+
+typedef ThreadRegistry<AbortRecord> AbortRecords;
+
+// The totals at the last reset(), subtracted from the records rather than
+// clearing them under their owners.
+static AbortStats baseline;
+static std::mutex baselineMutex;
+
+static AbortStats sumAbortRecords()
+{
+    AbortStats stats;
+    AbortRecords::forEach([&stats](AbortRecord & r) {
+        for (size_t i = 0; i < NUM_ABORT_CAUSES; i++) {
+            stats.counts[i] += r.counts[i].load(std::memory_order_relaxed);
+        }
+    });
+    return stats;
+}
+
+uint64_t AbortStats::total() const
+{
+    uint64_t sum = 0;
+    for (auto count : counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+const char * AbortStats::causeName(AbortCause cause)
+{
+    switch (cause) {
+    case ABORT_LOCKED:
+        return "locked";
+    case ABORT_NEWER_VERSION:
+        return "newer version";
+    case ABORT_CHANGED_DURING_READ:
+        return "changed during read";
+    case ABORT_COMMIT_LOCK:
+        return "commit lock";
+    case ABORT_VALIDATION:
+        return "validation";
+    case ABORT_EXPLICIT:
+        return "explicit";
+    default:
+        return "unknown";
+    }
+}
+
+void AbortStats::record(AbortCause cause)
+{
+    std::atomic<uint64_t> & count = AbortRecords::local().counts[cause];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+AbortStats AbortStats::collect()
+{
+    std::lock_guard<std::mutex> guard(baselineMutex);
+    AbortStats stats = sumAbortRecords();
+    for (size_t i = 0; i < NUM_ABORT_CAUSES; i++) {
+        stats.counts[i] -= baseline.counts[i];
+    }
+    return stats;
+}
+
+void AbortStats::reset()
+{
+    std::lock_guard<std::mutex> guard(baselineMutex);
+    baseline = sumAbortRecords();
+}
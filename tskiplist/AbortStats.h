@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Utils.h"
+
+// Why a transaction was aborted.
+enum AbortCause
+{
+    // A read found the node locked by a committer.
+    ABORT_LOCKED,
+    // A read found a version newer than the transaction's readVersion.
+    ABORT_NEWER_VERSION,
+    // The node was locked or committed while a read copied its fields.
+    ABORT_CHANGED_DURING_READ,
+    // WriteSet::tryLock failed at commit.
+    ABORT_COMMIT_LOCK,
+    // validateReadSet failed, at commit or after a nested rollback.
+    ABORT_VALIDATION,
+    // The application aborted a transaction that had not conflicted.
+    ABORT_EXPLICIT,
+    NUM_ABORT_CAUSES
+};
+
+// Abort counts by cause. Every thread counts its own aborts without
+// touching shared state; collect() sums them on demand.
+class AbortStats
+{
+public:
+    AbortStats()
+    {
+        std::fill(counts, counts + NUM_ABORT_CAUSES, 0);
+    }
+
+    uint64_t total() const;
+
+    static const char * causeName(AbortCause cause);
+
+    // Counts an abort of the calling thread.
+    static void record(AbortCause cause);
+
+    // The counts of every thread since the last reset, including exited
+    // ones. Counts of running threads may lag behind by the aborts in
+    // progress.
+    static AbortStats collect();
+
+    // Safe while transactions run; only the totals start over.
+    static void reset();
+
+    uint64_t counts[NUM_ABORT_CAUSES];
+};
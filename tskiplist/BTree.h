@@ -0,0 +1,678 @@
+#pragma once
+
+#include "Utils.h"
+#include "Epoch.h"
+#include "Node.h"
+#include "SlabAllocator.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+// A B+-tree of (key, node) pairs with optimistic lock coupling (Leis et al.,
+// "The ART of Practical Synchronization"), for indexing a SkipList.
+//
+// Pages keep their keys and nodes in sorted arrays. Readers take no locks:
+// they note a page's version, read it and check that the version did not
+// change, restarting from the root if it did. Writers lock only the pages
+// they change, and split full pages on the way down so that a split never
+// has to propagate upwards. Pairs are ordered by key, then by node address,
+// so a key may be indexed for several nodes at once.
+//
+// A leaf that loses its last pair is unlinked from its parent, along with
+// any ancestors left without children, and retired through Epoch; pages are
+// not merged otherwise. Every operation must therefore run in an Epoch
+// critical region. Optimistic readers may copy a key while it is being
+// overwritten, which is why keys must be trivially copyable.
+template <typename Key, typename Compare = std::less<Key>>
+class OLCBTree
+{
+public:
+    OLCBTree();
+
+    ~OLCBTree();
+
+    void insert(const Key & k, NodeBase * node);
+
+    // Returns false if the pair is not in the tree.
+    bool erase(const Key & k, NodeBase * node);
+
+    // The node of the last pair with a key smaller than k, or NULL.
+    NodeBase * findSmaller(const Key & k) const;
+
+    size_t size() const
+    {
+        return numEntries.load(std::memory_order_relaxed);
+    }
+
+    // Levels from the root to the leaves.
+    size_t height() const;
+
+    // Pages in the tree. This is purely for test-purposes.
+    size_t pages() const
+    {
+        return numPages.load();
+    }
+
+    Compare compare;
+
+private:
+    static_assert(std::is_trivially_copyable<Key>::value,
+                  "OLCBTree reads keys optimistically");
+
+    static constexpr size_t PAGE_SIZE = 1024;
+
+    // Deeper than any tree grows: a level is only added by splitting a full
+    // root.
+    static constexpr size_t MAX_HEIGHT = 32;
+
+    // A version word. Bit 1 is set while a writer holds the page, bit 0 once
+    // the page was unlinked from the tree.
+    class OptimisticLock
+    {
+    public:
+        OptimisticLock() : word(0) {}
+
+        // The version to validate against, or false if a writer holds the
+        // page or it is gone.
+        bool readLock(uint64_t & version) const
+        {
+            version = word.load(std::memory_order_acquire);
+            if ((version & 3) != 0) {
+                std::this_thread::yield();
+                return false;
+            }
+            return true;
+        }
+
+        // Whether nothing changed since version was read.
+        bool validate(uint64_t version) const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return word.load(std::memory_order_relaxed) == version;
+        }
+
+        // Takes the lock if nothing changed since version was read.
+        bool upgrade(uint64_t version)
+        {
+            return word.compare_exchange_strong(version, version + 2);
+        }
+
+        void unlock()
+        {
+            word.fetch_add(2, std::memory_order_release);
+        }
+
+        // Unlocks a page that was unlinked, for good.
+        void unlockObsolete()
+        {
+            word.fetch_add(3, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<uint64_t> word;
+    };
+
+    class Page
+    {
+    public:
+        Page(bool leaf) : count(0), leaf(leaf) {}
+
+        OptimisticLock lock;
+        uint16_t count;
+        bool leaf;
+    };
+
+    class Leaf : public Page
+    {
+    public:
+        static constexpr size_t CAPACITY =
+            (PAGE_SIZE - sizeof(Page)) / (sizeof(Key) + sizeof(NodeBase *));
+
+        Leaf() : Page(true) {}
+
+        Key keys[CAPACITY];
+        NodeBase * nodes[CAPACITY];
+    };
+
+    // children[i] holds the pairs from separator i - 1 up to separator i.
+    class Inner : public Page
+    {
+    public:
+        static constexpr size_t CAPACITY =
+            (PAGE_SIZE - sizeof(Page) - sizeof(Page *)) /
+            (sizeof(Key) + sizeof(NodeBase *) + sizeof(Page *));
+
+        Inner() : Page(false) {}
+
+        Key keys[CAPACITY];
+        NodeBase * nodes[CAPACITY];
+        Page * children[CAPACITY + 1];
+    };
+
+    typedef SlabAllocator<cacheLineAligned(sizeof(Leaf))> LeafAllocator;
+    typedef SlabAllocator<cacheLineAligned(sizeof(Inner))> InnerAllocator;
+
+    // Whether the pair (a, an) orders before (b, bn).
+    bool pairLess(const Key & a, const NodeBase * an, const Key & b, const NodeBase * bn) const
+    {
+        if (compare(a, b)) {
+            return true;
+        }
+        return !compare(b, a) && std::less<const NodeBase *>()(an, bn);
+    }
+
+    // The number of a page's pairs ordered before (k, node). count is
+    // clamped, since optimistic readers may see it torn.
+    template <typename PageType>
+    size_t lowerBound(const PageType * page, const Key & k, const NodeBase * node) const;
+
+    // The number of a page's pairs ordered before or equal to (k, node).
+    template <typename PageType>
+    size_t upperBound(const PageType * page, const Key & k, const NodeBase * node) const;
+
+    // The number of a page's keys smaller than k.
+    template <typename PageType>
+    size_t keysBefore(const PageType * page, const Key & k) const;
+
+    // One attempt of insert; false means restart.
+    bool tryInsert(const Key & k, NodeBase * node);
+
+    // One attempt of erase; false means restart, erased the outcome.
+    bool tryErase(const Key & k, NodeBase * node, bool & erased);
+
+    // Splits the full page under its locked parent (NULL for the root),
+    // both of which the caller unlocks.
+    void split(Page * page, Inner * parent);
+
+    // Drops children[pos] of a locked page with at least two children.
+    static void removeChild(Inner * inner, size_t pos);
+
+    // Unlocks a page that was unlinked and frees it once no reader can
+    // still see it.
+    void retire(Page * page);
+
+    // The node of the last pair smaller than k in page's subtree; restart
+    // is set if a version check failed.
+    NodeBase * findSmaller(const Page * page, uint64_t version, const Key & k,
+                           bool & restart) const;
+
+    // The node of the last pair in page's subtree.
+    NodeBase * findLast(const Page * page, uint64_t version, bool & restart) const;
+
+    static void destroy(Page * page);
+
+    // Epoch::Reclaimer for retired pages; leaves their children alone.
+    static void reclaim(void * page);
+
+    Leaf * createLeaf()
+    {
+        numPages.fetch_add(1, std::memory_order_relaxed);
+        return new (LeafAllocator::allocate()) Leaf();
+    }
+
+    Inner * createInner()
+    {
+        numPages.fetch_add(1, std::memory_order_relaxed);
+        return new (InnerAllocator::allocate()) Inner();
+    }
+
+    std::atomic<Page *> root;
+    std::atomic<size_t> numEntries;
+    std::atomic<size_t> numPages;
+};
+
+template <typename Key, typename Compare>
+OLCBTree<Key, Compare>::OLCBTree() : numEntries(0), numPages(0)
+{
+    root = createLeaf();
+}
+
+template <typename Key, typename Compare>
+OLCBTree<Key, Compare>::~OLCBTree()
+{
+    destroy(root.load());
+}
+
+template <typename Key, typename Compare>
+void OLCBTree<Key, Compare>::destroy(Page * page)
+{
+    if (page->leaf) {
+        static_cast<Leaf *>(page)->~Leaf();
+        LeafAllocator::release(page);
+        return;
+    }
+
+    Inner * inner = static_cast<Inner *>(page);
+    for (size_t i = 0; i <= inner->count; i++) {
+        destroy(inner->children[i]);
+    }
+    inner->~Inner();
+    InnerAllocator::release(inner);
+}
+
+template <typename Key, typename Compare>
+void OLCBTree<Key, Compare>::reclaim(void * block)
+{
+    Page * page = static_cast<Page *>(block);
+    if (page->leaf) {
+        static_cast<Leaf *>(page)->~Leaf();
+        LeafAllocator::release(page);
+    } else {
+        static_cast<Inner *>(page)->~Inner();
+        InnerAllocator::release(page);
+    }
+}
+
+template <typename Key, typename Compare>
+void OLCBTree<Key, Compare>::retire(Page * page)
+{
+    page->lock.unlockObsolete();
+    numPages.fetch_sub(1, std::memory_order_relaxed);
+    Epoch::retire(page, reclaim);
+}
+
+template <typename Key, typename Compare>
+template <typename PageType>
+size_t OLCBTree<Key, Compare>::lowerBound(const PageType * page, const Key & k,
+        const NodeBase * node) const
+{
+    size_t low = 0, high = std::min<size_t>(page->count, PageType::CAPACITY);
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (pairLess(page->keys[mid], page->nodes[mid], k, node)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+template <typename Key, typename Compare>
+template <typename PageType>
+size_t OLCBTree<Key, Compare>::upperBound(const PageType * page, const Key & k,
+        const NodeBase * node) const
+{
+    size_t low = 0, high = std::min<size_t>(page->count, PageType::CAPACITY);
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (!pairLess(k, node, page->keys[mid], page->nodes[mid])) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+template <typename Key, typename Compare>
+template <typename PageType>
+size_t OLCBTree<Key, Compare>::keysBefore(const PageType * page, const Key & k) const
+{
+    const size_t count = std::min<size_t>(page->count, PageType::CAPACITY);
+    return std::lower_bound(page->keys, page->keys + count, k, compare) - page->keys;
+}
+
+template <typename Key, typename Compare>
+size_t OLCBTree<Key, Compare>::height() const
+{
+    size_t levels = 1;
+    for (const Page * page = root.load(); !page->leaf;
+            page = static_cast<const Inner *>(page)->children[0]) {
+        levels++;
+    }
+    return levels;
+}
+
+template <typename Key, typename Compare>
+void OLCBTree<Key, Compare>::insert(const Key & k, NodeBase * node)
+{
+    while (!tryInsert(k, node)) {
+    }
+    numEntries.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename Key, typename Compare>
+bool OLCBTree<Key, Compare>::tryInsert(const Key & k, NodeBase * node)
+{
+    Page * page = root.load(std::memory_order_acquire);
+    uint64_t version;
+    if (!page->lock.readLock(version) || page != root.load()) {
+        return false;
+    }
+
+    Inner * parent = NULL;
+    uint64_t parentVersion = 0;
+    for (;;) {
+        const bool full = page->leaf ? page->count == Leaf::CAPACITY
+                          : page->count == Inner::CAPACITY;
+        if (full) {
+            // Split it now, so that the parent, split on the way down if it
+            // was full, has room for the separator.
+            if (parent != NULL && !parent->lock.upgrade(parentVersion)) {
+                return false;
+            }
+            if (!page->lock.upgrade(version)) {
+                if (parent != NULL) {
+                    parent->lock.unlock();
+                }
+                return false;
+            }
+            if (parent == NULL && page != root.load()) {
+                page->lock.unlock();
+                return false;
+            }
+            split(page, parent);
+            page->lock.unlock();
+            if (parent != NULL) {
+                parent->lock.unlock();
+            }
+            return false;
+        }
+
+        if (page->leaf) {
+            break;
+        }
+        // The child pointer is only safe to follow once the page validates.
+        Inner * inner = static_cast<Inner *>(page);
+        Page * child = inner->children[upperBound(inner, k, node)];
+        if (!inner->lock.validate(version)) {
+            return false;
+        }
+        if (parent != NULL && !parent->lock.validate(parentVersion)) {
+            return false;
+        }
+        uint64_t childVersion;
+        if (!child->lock.readLock(childVersion)) {
+            return false;
+        }
+        parent = inner;
+        parentVersion = version;
+        page = child;
+        version = childVersion;
+    }
+
+    Leaf * leaf = static_cast<Leaf *>(page);
+    if (!leaf->lock.upgrade(version)) {
+        return false;
+    }
+    const size_t pos = lowerBound(leaf, k, node);
+    for (size_t i = leaf->count; i > pos; i--) {
+        leaf->keys[i] = leaf->keys[i - 1];
+        leaf->nodes[i] = leaf->nodes[i - 1];
+    }
+    leaf->keys[pos] = k;
+    leaf->nodes[pos] = node;
+    leaf->count++;
+    leaf->lock.unlock();
+    return true;
+}
+
+template <typename Key, typename Compare>
+void OLCBTree<Key, Compare>::split(Page * page, Inner * parent)
+{
+    Key separator;
+    NodeBase * separatorNode;
+    Page * right;
+    if (page->leaf) {
+        Leaf * left = static_cast<Leaf *>(page);
+        Leaf * sibling = createLeaf();
+        const size_t keep = left->count / 2;
+        sibling->count = (uint16_t)(left->count - keep);
+        std::copy(left->keys + keep, left->keys + left->count, sibling->keys);
+        std::copy(left->nodes + keep, left->nodes + left->count, sibling->nodes);
+        left->count = (uint16_t)keep;
+        separator = sibling->keys[0];
+        separatorNode = sibling->nodes[0];
+        right = sibling;
+    } else {
+        // The middle separator moves up.
+        Inner * left = static_cast<Inner *>(page);
+        Inner * sibling = createInner();
+        const size_t middle = left->count / 2;
+        sibling->count = (uint16_t)(left->count - middle - 1);
+        std::copy(left->keys + middle + 1, left->keys + left->count, sibling->keys);
+        std::copy(left->nodes + middle + 1, left->nodes + left->count, sibling->nodes);
+        std::copy(left->children + middle + 1, left->children + left->count + 1,
+                  sibling->children);
+        separator = left->keys[middle];
+        separatorNode = left->nodes[middle];
+        left->count = (uint16_t)middle;
+        right = sibling;
+    }
+
+    if (parent == NULL) {
+        Inner * newRoot = createInner();
+        newRoot->count = 1;
+        newRoot->keys[0] = separator;
+        newRoot->nodes[0] = separatorNode;
+        newRoot->children[0] = page;
+        newRoot->children[1] = right;
+        root.store(newRoot, std::memory_order_release);
+        return;
+    }
+
+    const size_t pos = lowerBound(parent, separator, separatorNode);
+    for (size_t i = parent->count; i > pos; i--) {
+        parent->keys[i] = parent->keys[i - 1];
+        parent->nodes[i] = parent->nodes[i - 1];
+        parent->children[i + 1] = parent->children[i];
+    }
+    parent->keys[pos] = separator;
+    parent->nodes[pos] = separatorNode;
+    parent->children[pos + 1] = right;
+    parent->count++;
+}
+
+template <typename Key, typename Compare>
+bool OLCBTree<Key, Compare>::erase(const Key & k, NodeBase * node)
+{
+    bool erased = false;
+    while (!tryErase(k, node, erased)) {
+    }
+    if (erased) {
+        numEntries.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return erased;
+}
+
+template <typename Key, typename Compare>
+bool OLCBTree<Key, Compare>::tryErase(const Key & k, NodeBase * node, bool & erased)
+{
+    // The inner pages on the way down, their versions and the child taken.
+    Inner * path[MAX_HEIGHT];
+    uint64_t versions[MAX_HEIGHT];
+    size_t positions[MAX_HEIGHT];
+    size_t depth = 0;
+
+    Page * page = root.load(std::memory_order_acquire);
+    uint64_t version;
+    if (!page->lock.readLock(version) || page != root.load()) {
+        return false;
+    }
+
+    while (!page->leaf) {
+        if (depth == MAX_HEIGHT) {
+            throw std::runtime_error("OLCBTree grew too deep");
+        }
+        Inner * inner = static_cast<Inner *>(page);
+        const size_t pos = upperBound(inner, k, node);
+        Page * child = inner->children[pos];
+        if (!inner->lock.validate(version)) {
+            return false;
+        }
+        uint64_t childVersion;
+        if (!child->lock.readLock(childVersion)) {
+            return false;
+        }
+        path[depth] = inner;
+        versions[depth] = version;
+        positions[depth] = pos;
+        depth++;
+        page = child;
+        version = childVersion;
+    }
+
+    Leaf * leaf = static_cast<Leaf *>(page);
+    const size_t count = leaf->count;
+    const size_t pos = lowerBound(leaf, k, node);
+    const bool found = pos < count && leaf->nodes[pos] == node;
+    if (!leaf->lock.validate(version)) {
+        return false;
+    }
+    if (!found) {
+        erased = false;
+        return true;
+    }
+
+    // An emptied leaf goes, and so do the ancestors it leaves without
+    // children: all of path[top ~ depth - 1]. path[top - 1], if any, keeps
+    // other children and loses one.
+    size_t top = depth;
+    if (count == 1) {
+        while (top > 0 && path[top - 1]->count == 0) {
+            top--;
+        }
+    }
+    const size_t first = count != 1 ? depth : top > 0 ? top - 1 : 0;
+    for (size_t i = first; i < depth; i++) {
+        if (!path[i]->lock.upgrade(versions[i])) {
+            while (i-- > first) {
+                path[i]->lock.unlock();
+            }
+            return false;
+        }
+    }
+    if (!leaf->lock.upgrade(version)) {
+        for (size_t i = first; i < depth; i++) {
+            path[i]->lock.unlock();
+        }
+        return false;
+    }
+
+    for (size_t i = pos + 1; i < count; i++) {
+        leaf->keys[i - 1] = leaf->keys[i];
+        leaf->nodes[i - 1] = leaf->nodes[i];
+    }
+    leaf->count--;
+    erased = true;
+    if (count != 1 || depth == 0) {
+        leaf->lock.unlock();
+        return true;
+    }
+
+    if (top == 0) {
+        // The tree is empty: start over from an empty leaf.
+        root.store(createLeaf(), std::memory_order_release);
+    } else {
+        Inner * parent = path[top - 1];
+        removeChild(parent, positions[top - 1]);
+        if (top == 1 && parent->count == 0) {
+            // A root with a single child hands over to it.
+            root.store(parent->children[0], std::memory_order_release);
+            retire(parent);
+        } else {
+            parent->lock.unlock();
+        }
+    }
+    for (size_t i = top; i < depth; i++) {
+        retire(path[i]);
+    }
+    retire(leaf);
+    return true;
+}
+
+template <typename Key, typename Compare>
+void OLCBTree<Key, Compare>::removeChild(Inner * inner, size_t pos)
+{
+    // children[pos - 1] (or children[1]) takes over its range.
+    for (size_t i = pos > 0 ? pos - 1 : 0; i + 1 < inner->count; i++) {
+        inner->keys[i] = inner->keys[i + 1];
+        inner->nodes[i] = inner->nodes[i + 1];
+    }
+    for (size_t i = pos; i < inner->count; i++) {
+        inner->children[i] = inner->children[i + 1];
+    }
+    inner->count--;
+}
+
+template <typename Key, typename Compare>
+NodeBase * OLCBTree<Key, Compare>::findSmaller(const Key & k) const
+{
+    for (;;) {
+        const Page * page = root.load(std::memory_order_acquire);
+        uint64_t version;
+        if (!page->lock.readLock(version) || page != root.load()) {
+            continue;
+        }
+        bool restart = false;
+        NodeBase * node = findSmaller(page, version, k, restart);
+        if (!restart) {
+            return node;
+        }
+    }
+}
+
+template <typename Key, typename Compare>
+NodeBase * OLCBTree<Key, Compare>::findSmaller(const Page * page, uint64_t version,
+        const Key & k, bool & restart) const
+{
+    if (page->leaf) {
+        const Leaf * leaf = static_cast<const Leaf *>(page);
+        const size_t pos = keysBefore(leaf, k);
+        NodeBase * node = pos > 0 ? leaf->nodes[pos - 1] : NULL;
+        restart = !leaf->lock.validate(version);
+        return node;
+    }
+
+    // Every pair smaller than k lies in children[0 ~ pos]; those of
+    // children[pos] may all be greater. Only the root leaf can be empty.
+    const Inner * inner = static_cast<const Inner *>(page);
+    const size_t pos = keysBefore(inner, k);
+    for (size_t i = pos + 1; i-- > 0;) {
+        const Page * child = inner->children[i];
+        uint64_t childVersion;
+        if (!inner->lock.validate(version) || !child->lock.readLock(childVersion)) {
+            restart = true;
+            return NULL;
+        }
+        NodeBase * node = i == pos ? findSmaller(child, childVersion, k, restart)
+                          : findLast(child, childVersion, restart);
+        if (restart || node != NULL) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+template <typename Key, typename Compare>
+NodeBase * OLCBTree<Key, Compare>::findLast(const Page * page, uint64_t version,
+        bool & restart) const
+{
+    if (page->leaf) {
+        const Leaf * leaf = static_cast<const Leaf *>(page);
+        const size_t count = std::min<size_t>(leaf->count, Leaf::CAPACITY);
+        NodeBase * node = count > 0 ? leaf->nodes[count - 1] : NULL;
+        restart = !leaf->lock.validate(version);
+        return node;
+    }
+
+    const Inner * inner = static_cast<const Inner *>(page);
+    const size_t count = std::min<size_t>(inner->count, Inner::CAPACITY);
+    for (size_t i = count + 1; i-- > 0;) {
+        const Page * child = inner->children[i];
+        uint64_t childVersion;
+        if (!inner->lock.validate(version) || !child->lock.readLock(childVersion)) {
+            restart = true;
+            return NULL;
+        }
+        NodeBase * node = findLast(child, childVersion, restart);
+        if (restart || node != NULL) {
+            return node;
+        }
+    }
+    return NULL;
+}
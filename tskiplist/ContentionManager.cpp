@@ -0,0 +1,46 @@
+#include "ContentionManager.h"
+
+#include <random>
+
+static std::minstd_rand & localGenerator()
+{
+    static thread_local std::minstd_rand generator(
+        (unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return generator;
+}
+
+static void waitFor(std::chrono::microseconds duration)
+{
+    const auto deadline = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+bool ContentionManager::onAbort(const Transaction & transaction)
+{
+    aborts++;
+    karma += transaction.readSet.size() + transaction.writeSet.size();
+    if (policy.abortBudget != 0 && aborts >= policy.abortBudget) {
+        return false;
+    }
+    // The irrevocable rerun waits for the token anyway.
+    if (policy.policy == CM_IMMEDIATE || runIrrevocably()) {
+        return true;
+    }
+
+    uint64_t window = policy.maxBackoff;
+    if (aborts - 1 < 32) {
+        window = std::min<uint64_t>(window, (uint64_t)policy.minBackoff << (aborts - 1));
+    }
+    if (policy.policy == CM_KARMA) {
+        window /= 1 + karma / KARMA_UNIT;
+    }
+    if (window == 0) {
+        return true;
+    }
+
+    std::uniform_int_distribution<uint64_t> distribution(0, window);
+    waitFor(std::chrono::microseconds(distribution(localGenerator())));
+    return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Utils.h"
+#include "GVC.h"
+#include "Transaction.h"
+
+// How atomically() waits before rerunning an aborted transaction.
+enum ContentionPolicy
+{
+    // Retry right away.
+    CM_IMMEDIATE,
+    // Wait a random time below a window that doubles with every abort.
+    CM_BACKOFF,
+    // Like CM_BACKOFF, but the window shrinks with the work (karma) the
+    // aborted attempts had done, so long transactions get back in sooner
+    // than the short ones that keep beating them (after Polka/Karma).
+    CM_KARMA
+};
+
+class RetryPolicy
+{
+public:
+    RetryPolicy(ContentionPolicy policy = CM_BACKOFF,
+                unsigned int abortBudget = 0,
+                unsigned int irrevocableAfter = 0) :
+        policy(policy), abortBudget(abortBudget),
+        irrevocableAfter(irrevocableAfter), minBackoff(1), maxBackoff(1024) {}
+
+    ContentionPolicy policy;
+    // Aborts after which atomically() gives up; 0 retries forever.
+    unsigned int abortBudget;
+    // Aborts after which atomically() reruns the transaction as
+    // TX_IRREVOCABLE, which cannot abort but stalls the commits of all other
+    // threads until it ends; 0 never does.
+    unsigned int irrevocableAfter;
+    // Bounds of the backoff window, in microseconds.
+    unsigned int minBackoff;
+    unsigned int maxBackoff;
+};
+
+// The per-call state of atomically().
+class ContentionManager
+{
+public:
+    ContentionManager(const RetryPolicy & policy) :
+        policy(policy), aborts(0), karma(0) {}
+
+    // Accounts for an aborted attempt of transaction and waits as the policy
+    // says. Returns false once the abort budget is used up.
+    bool onAbort(const Transaction & transaction);
+
+    unsigned int retries() const
+    {
+        return aborts;
+    }
+
+    bool runIrrevocably() const
+    {
+        return policy.irrevocableAfter != 0 && aborts >= policy.irrevocableAfter;
+    }
+
+private:
+    // CM_KARMA divides the window by 1 + karma / KARMA_UNIT; karma counts
+    // the nodes read and written by the aborted attempts.
+    static constexpr size_t KARMA_UNIT = 8;
+
+    const RetryPolicy & policy;
+    unsigned int aborts;
+    size_t karma;
+};
+
+// Runs fn(transaction) in a transaction on clock and commits it, rerunning
+// both after every abort. fn may use the throwing or the non-throwing API
+// of any TDS on clock; other exceptions abort the transaction and propagate.
+// Returns the number of retries, or throws AbortTransactionException once
+// the policy's abort budget is used up. Past the policy's irrevocableAfter
+// aborts the transaction runs irrevocably and no longer aborts on conflicts.
+template <typename Fn>
+unsigned int atomically(GVC & clock, Fn fn,
+                        const RetryPolicy & policy = RetryPolicy(),
+                        TransactionType type = TX_READ_WRITE)
+{
+    ContentionManager manager(policy);
+    Transaction transaction;
+    for (;;) {
+        transaction.begin(clock, manager.runIrrevocably() ? TX_IRREVOCABLE : type);
+        try {
+            fn(transaction);
+            if (transaction.tryCommit()) {
+                return manager.retries();
+            }
+        } catch (AbortTransactionException &) {
+            transaction.abort();
+        }
+
+        if (!manager.onAbort(transaction)) {
+            throw AbortTransactionException();
+        }
+    }
+}
+
+// Runs fn(transaction) as a child of transaction (see
+// Transaction::beginNested), rerunning only the child after it aborts.
+// Returns the number of retries, or throws AbortTransactionException once
+// the parent itself is invalid; atomically() then reruns the parent.
+template <typename Fn>
+unsigned int atomicallyNested(Transaction & transaction, Fn fn)
+{
+    unsigned int retries = 0;
+    for (;;) {
+        transaction.beginNested();
+        try {
+            fn(transaction);
+            if (transaction.tryCommitNested()) {
+                return retries;
+            }
+        } catch (AbortTransactionException &) {
+            transaction.abortNested();
+        }
+
+        if (transaction.aborted) {
+            throw AbortTransactionException();
+        }
+        retries++;
+        // Usually a committer still holds the lock the child ran into.
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,118 @@
+#include "Epoch.h"
+
+// Retire this many objects before trying to advance the epoch.
+static constexpr size_t RECLAIM_THRESHOLD = 64;
+
+static constexpr uint64_t QUIESCENT = ~0ULL;
+
+class Retired
+{
+public:
+    void * object;
+    Epoch::Reclaimer reclaim;
+    uint64_t epoch;
+};
+
+class ThreadRecord
+{
+public:
+    ThreadRecord() : epoch(QUIESCENT), nesting(0) {}
+
+    std::atomic<uint64_t> epoch;
+    unsigned int nesting;
+    std::vector<Retired> limbo;
+};
+
+// A thread that exits leaves its record (and any objects still waiting in
+// its limbo list) to the next thread.
+static void leaveRecord(ThreadRecord & record)
+{
+    record.epoch.store(QUIESCENT);
+    record.nesting = 0;
+}
+
+typedef ThreadRegistry<ThreadRecord, leaveRecord> ThreadRecords;
+
+static std::atomic<uint64_t> globalEpoch(0);
+
+static ThreadRecord & localRecord()
+{
+    return ThreadRecords::local();
+}
+
+static bool tryAdvance()
+{
+    uint64_t current = globalEpoch.load();
+    bool behind = false;
+    ThreadRecords::forEach([&](ThreadRecord & r) {
+        const uint64_t e = r.epoch.load();
+        behind = behind || (e != QUIESCENT && e != current);
+    });
+    return !behind && globalEpoch.compare_exchange_strong(current, current + 1);
+}
+
+void Epoch::enter()
+{
+    ThreadRecord & r = localRecord();
+    if (r.nesting++ > 0) {
+        return;
+    }
+
+    uint64_t e;
+    do {
+        e = globalEpoch.load();
+        r.epoch.store(e);
+    } while (globalEpoch.load() != e);
+}
+
+void Epoch::exit()
+{
+    ThreadRecord & r = localRecord();
+    if (--r.nesting == 0) {
+        r.epoch.store(QUIESCENT, std::memory_order_release);
+    }
+}
+
+bool Epoch::isActive()
+{
+    return localRecord().nesting > 0;
+}
+
+void Epoch::retire(void * object, Reclaimer reclaim)
+{
+    ThreadRecord & r = localRecord();
+    Retired retired;
+    retired.object = object;
+    retired.reclaim = reclaim;
+    retired.epoch = globalEpoch.load();
+    r.limbo.push_back(retired);
+
+    if (r.limbo.size() % RECLAIM_THRESHOLD == 0) {
+        collect();
+    }
+}
+
+size_t Epoch::collect()
+{
+    ThreadRecord & r = localRecord();
+    tryAdvance();
+
+    const uint64_t current = globalEpoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < r.limbo.size(); i++) {
+        if (r.limbo[i].epoch + 2 <= current) {
+            r.limbo[i].reclaim(r.limbo[i].object);
+        } else {
+            r.limbo[kept++] = r.limbo[i];
+        }
+    }
+
+    const size_t reclaimed = r.limbo.size() - kept;
+    r.limbo.resize(kept);
+    return reclaimed;
+}
+
+size_t Epoch::pending()
+{
+    return localRecord().limbo.size();
+}
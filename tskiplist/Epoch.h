@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Utils.h"
+
+// Epoch-based reclamation, along the lines of bench/common/fraser/gc.c.
+//
+// Threads announce the global epoch while they may hold pointers into shared
+// structures (enter/exit nest). Retired objects are reclaimed once the global
+// epoch has advanced twice since their retirement, which can only happen
+// after every thread that was inside a critical region at that time left it.
+class Epoch
+{
+public:
+    typedef void (*Reclaimer)(void * object);
+
+    static void enter();
+
+    static void exit();
+
+    static bool isActive();
+
+    // Hands `object` to `reclaim` once no thread can reference it anymore.
+    // Must be called after the object was unlinked from every shared path.
+    static void retire(void * object, Reclaimer reclaim);
+
+    // Attempts to advance the epoch and reclaims whatever the calling thread
+    // retired that became safe. Returns the number of reclaimed objects.
+    static size_t collect();
+
+    // Number of objects retired by the calling thread and not yet reclaimed.
+    static size_t pending();
+};
+
+class EpochGuard
+{
+public:
+    EpochGuard()
+    {
+        Epoch::enter();
+    }
+
+    ~EpochGuard()
+    {
+        Epoch::exit();
+    }
+};
@@ -2,23 +2,107 @@
 
 #include "Utils.h"
 
+// Global version clock strategies (see the TL2 paper for GV4/GV5/GV6).
+enum GVCMode
+{
+    // Every committing writer increments the clock.
+    GV1,
+    // Writers try to CAS the clock forward once; on failure they share the
+    // timestamp installed by the winner.
+    GV4,
+    // Writers use clock + 1 without storing it; the clock only advances when
+    // a reader aborts on a version newer than its read version.
+    GV5,
+    // GV5, but every GV6_PERIOD-th commit of a thread advances like GV4.
+    GV6,
+    // GV5, and every thread publishes its latest write version once per
+    // BATCH_SIZE commits.
+    GV_BATCHED
+};
+
 class GVC
 {
 public:
-    GVC() : version(0) {}
+    static constexpr unsigned int GV6_PERIOD = 32;
+    static constexpr unsigned int BATCH_SIZE = 16;
+
+    GVC(GVCMode mode = GV1) : mode(mode), version(0) {}
 
     virtual ~GVC() = default;
 
-    unsigned int read() const
+    GVCMode getMode() const
+    {
+        return mode;
+    }
+
+    VersionType read() const
     {
         return version.load();
     }
 
-    unsigned int addAndFetch()
+    // Returns the write version of a committing transaction. Must be called
+    // after its write set is locked.
+    VersionType addAndFetch()
+    {
+        switch (mode) {
+        case GV4:
+            return passOnFailure();
+        case GV5:
+        case GV_BATCHED:
+            return version.load() + 1;
+        case GV6:
+            if (++commitCounter() % GV6_PERIOD == 0) {
+                return passOnFailure();
+            }
+            return version.load() + 1;
+        case GV1:
+        default:
+            return std::atomic_fetch_add<VersionType>(&version, 1) + 1;
+        }
+    }
+
+    // Called once the writes of writeVersion are visible and unlocked.
+    void committed(VersionType writeVersion)
+    {
+        if (mode == GV_BATCHED && ++commitCounter() % BATCH_SIZE == 0) {
+            advanceTo(writeVersion);
+        }
+    }
+
+    // Called when a transaction aborts because it saw a committed version
+    // newer than its read version.
+    void onAbort(VersionType seen)
     {
-        return std::atomic_fetch_add<unsigned int>(&version, 1) + 1;
+        if (mode != GV1 && mode != GV4) {
+            advanceTo(seen);
+        }
     }
 
 private:
-    std::atomic<unsigned int> version;
+    VersionType passOnFailure()
+    {
+        VersionType current = version.load();
+        if (version.compare_exchange_strong(current, current + 1)) {
+            return current + 1;
+        }
+        // Somebody else moved the clock since; `current` holds its value.
+        return current;
+    }
+
+    void advanceTo(VersionType target)
+    {
+        VersionType current = version.load();
+        while (current < target &&
+                !version.compare_exchange_weak(current, target)) {
+        }
+    }
+
+    static unsigned int & commitCounter()
+    {
+        static thread_local unsigned int counter = 0;
+        return counter;
+    }
+
+    const GVCMode mode;
+    std::atomic<VersionType> version;
 };
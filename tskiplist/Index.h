@@ -2,8 +2,12 @@
 
 #include "Node.h"
 #include "Utils.h"
+#include "Epoch.h"
+#include "IndexBackend.h"
 #include "skiplist/skiplist.h"
 
+#include <functional>
+
 enum OperationType
 {
     REMOVE,
@@ -14,30 +18,338 @@ enum OperationType
 class IndexOperation
 {
 public:
-    IndexOperation(Node * node, OperationType op) : node(node), op(op) {}
+    IndexOperation(NodeBase * node, OperationType op) : node(node), op(op) {}
 
-    Node * node;
+    NodeBase * node;
     OperationType op;
 };
 
+// Backend is the structure holding the indexed nodes (see IndexBackend.h).
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Backend = DefaultIndexBackend<Key, Value, Compare>>
 class Index
 {
 public:
-    Index(unsigned int version);
+    typedef Node<Key, Value> NodeType;
+
+    // config shapes a skiplist backend; its aux is ignored.
+    Index(VersionType version,
+          const skiplist_raw_config & config = skiplist_get_default_config());
+
+    ~Index();
 
     void update(std::vector<IndexOperation> & ops);
 
-    bool insert(Node * node);
+    bool insert(NodeType * node);
+
+    bool remove(NodeType * node);
+
+    // The last indexed node with a key smaller than k, or the head sentinel
+    // if there is none. A pure read of the index: it takes no locks and
+    // leaves no ref counts, so it must run in an Epoch critical region,
+    // which keeps removed nodes alive.
+    NodeType * getPrev(const Key & k);
+
+    // A random index height for a node about to be created (see
+    // Node::create).
+    size_t chooseTopLayer()
+    {
+        return backend.chooseTopLayer();
+    }
+
+    NodeType * getHead()
+    {
+        return &head;
+    }
+
+    // The current shape of the index skiplist, including any layers it has
+    // grown since.
+    skiplist_raw_config getConfig()
+    {
+        return backend.getConfig();
+    }
 
-    bool remove(Node * node);
+    bool isHead(NodeBase * node)
+    {
+        return node == &head;
+    }
 
-    Node * getPrev(const ItemType & k);
+    // Background maintenance: once started, update() only enqueues the
+    // operations and numThreads maintainer threads apply them in key-sorted
+    // batches. Traversals tolerate the resulting stale index since they walk
+    // the bottom-level list from getPrev. Start and stop while no
+    // transaction is committing.
+    void startMaintenance(unsigned int numThreads = 1);
+
+    void stopMaintenance();
+
+    // Blocks until every enqueued operation was applied.
+    void flush();
 
     // These methods are purely for test-purposes and are not meant to be used by TDSs.
     long sum();
     long size();
 
+    Compare compare;
+
 private:
-    Node head;
-    skiplist_raw sl;
+    class Batch
+    {
+    public:
+        std::vector<IndexOperation> ops;
+        Batch * next;
+    };
+
+    // Committers push whole batches onto a lock-free stack; the maintainer
+    // takes all of them at once and restores their push order.
+    class MaintenanceQueue
+    {
+    public:
+        MaintenanceQueue() : head(NULL) {}
+
+        std::atomic<Batch *> head;
+        std::thread thread;
+        // REMOVEs whose INSERT was not applied yet; maintainer-private.
+        std::vector<IndexOperation> deferred;
+    };
+
+    // Returns false for a REMOVE whose node was not indexed yet.
+    bool apply(IndexOperation & op);
+
+    void enqueue(std::vector<IndexOperation> & ops);
+
+    void maintain(MaintenanceQueue & queue);
+
+    size_t drain(MaintenanceQueue & queue);
+
+    NodeType head;
+    Backend backend;
+
+    std::vector<std::unique_ptr<MaintenanceQueue>> queues;
+    std::atomic<bool> stopping;
+    std::atomic<size_t> pending;
 };
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+Index<Key, Value, Compare, Backend>::Index(VersionType version,
+                                  const skiplist_raw_config & config) :
+    head(Key(), Value(), version), backend(&head, config),
+    stopping(false), pending(0)
+{
+    head.indexed = true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+Index<Key, Value, Compare, Backend>::~Index()
+{
+    stopMaintenance();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void Index<Key, Value, Compare, Backend>::update(std::vector<IndexOperation> & ops)
+{
+    if (!queues.empty()) {
+        enqueue(ops);
+        return;
+    }
+
+    for (auto & op : ops) {
+        while (!apply(op)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool Index<Key, Value, Compare, Backend>::apply(IndexOperation & op)
+{
+    NodeType * node = static_cast<NodeType *>(op.node);
+    if (op.op == OperationType::REMOVE) {
+        // The commit that inserted the node may still be indexing it.
+        if (!node->indexed.load()) {
+            return false;
+        }
+        if (!remove(node)) {
+            throw std::runtime_error("Failed during Index update!");
+        }
+        // Unlinked from both the list and the index: free once no running
+        // transaction can still hold it.
+        Epoch::retire(op.node, NodeType::reclaim);
+    } else {
+        if (!insert(node)) {
+            throw std::runtime_error("Failed during Index update!");
+        }
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void Index<Key, Value, Compare, Backend>::startMaintenance(unsigned int numThreads)
+{
+    stopMaintenance();
+
+    stopping = false;
+    for (unsigned int i = 0; i < numThreads; i++) {
+        queues.push_back(std::unique_ptr<MaintenanceQueue>(new MaintenanceQueue()));
+    }
+    for (auto & queue : queues) {
+        queue->thread = std::thread(&Index::maintain, this, std::ref(*queue));
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void Index<Key, Value, Compare, Backend>::stopMaintenance()
+{
+    if (queues.empty()) {
+        return;
+    }
+
+    stopping = true;
+    for (auto & queue : queues) {
+        queue->thread.join();
+    }
+    for (auto & queue : queues) {
+        drain(*queue);
+    }
+    queues.clear();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void Index<Key, Value, Compare, Backend>::flush()
+{
+    while (pending.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void Index<Key, Value, Compare, Backend>::enqueue(std::vector<IndexOperation> & ops)
+{
+    if (ops.empty()) {
+        return;
+    }
+
+    // All operations on a node go to the same maintainer, which keeps them
+    // in commit order.
+    std::vector<Batch *> batches(queues.size(), NULL);
+    for (auto & op : ops) {
+        const size_t q = ((uintptr_t)op.node >> 4) % queues.size();
+        if (!batches[q]) {
+            batches[q] = new Batch();
+        }
+        batches[q]->ops.push_back(op);
+    }
+
+    pending.fetch_add(ops.size());
+    for (size_t q = 0; q < queues.size(); q++) {
+        Batch * batch = batches[q];
+        if (!batch) {
+            continue;
+        }
+        batch->next = queues[q]->head.load();
+        while (!queues[q]->head.compare_exchange_weak(batch->next, batch)) {
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void Index<Key, Value, Compare, Backend>::maintain(MaintenanceQueue & queue)
+{
+    while (drain(queue) != 0 || !queue.deferred.empty() || !stopping.load()) {
+        if (queue.head.load() == NULL) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+size_t Index<Key, Value, Compare, Backend>::drain(MaintenanceQueue & queue)
+{
+    Batch * batch = queue.head.exchange(NULL);
+    if (!batch && queue.deferred.empty()) {
+        return 0;
+    }
+
+    // The stack holds the newest batch first.
+    std::vector<Batch *> batches;
+    for (; batch != NULL; batch = batch->next) {
+        batches.push_back(batch);
+    }
+
+    std::vector<IndexOperation> ops;
+    ops.swap(queue.deferred);
+    for (auto it = batches.rbegin(); it != batches.rend(); ++it) {
+        ops.insert(ops.end(), (*it)->ops.begin(), (*it)->ops.end());
+        delete *it;
+    }
+    std::stable_sort(ops.begin(), ops.end(),
+    [this](const IndexOperation & a, const IndexOperation & b) {
+        return compare(static_cast<NodeType *>(a.node)->key,
+                       static_cast<NodeType *>(b.node)->key);
+    });
+
+    EpochGuard guard;
+    for (auto & op : ops) {
+        // A REMOVE can overtake the INSERT of its node; retry it next time.
+        if (!apply(op)) {
+            queue.deferred.push_back(op);
+        }
+    }
+
+    const size_t applied = ops.size() - queue.deferred.size();
+    pending.fetch_sub(applied);
+    return applied;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool Index<Key, Value, Compare, Backend>::insert(NodeType * n)
+{
+    // A node removed by a later commit before it got indexed is skipped;
+    // its REMOVE then finds it unlinked.
+    if (!n->deleted) {
+        backend.insert(n);
+    }
+    n->indexed = true;
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool Index<Key, Value, Compare, Backend>::remove(NodeType * n)
+{
+    backend.erase(n);
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+typename Index<Key, Value, Compare, Backend>::NodeType * Index<Key, Value, Compare, Backend>::getPrev(
+    const Key & k)
+{
+    NodeType * prev = backend.findSmaller(k);
+    return prev != NULL ? prev : &head;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+long Index<Key, Value, Compare, Backend>::sum()
+{
+    long sum = 0;
+    NodeType * n = head.getNext();
+    while (n != NULL) {
+        sum += n->key;
+        n = n->getNext();
+    }
+
+    return sum;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+long Index<Key, Value, Compare, Backend>::size()
+{
+    long size = 0;
+    NodeType * n = head.getNext();
+    while (n != NULL) {
+        size++;
+        n = n->getNext();
+    }
+
+    return size;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Node.h"
+#include "Utils.h"
+#include "BTree.h"
+#include "KeySkipList.h"
+#include "skiplist/skiplist.h"
+
+#include <functional>
+
+// The structures an Index can keep its nodes in. A backend is constructed
+// with the head sentinel, which orders before every key and is never
+// inserted nor erased through it, and provides:
+// - insert(node) and erase(node);
+// - findSmaller(k): the last node with a key smaller than k, or NULL if
+//   there is none, without locks or ref counts (callers hold an Epoch);
+// - chooseTopLayer(): the height to create nodes with (see Node::create);
+// - getConfig(): its current shape, as far as it has one.
+
+// The raw skiplist, linked through Node::snode: lock-based by default,
+// skiplist_lf_* with LockFree.
+template <typename Key, typename Value, typename Compare = std::less<Key>, bool LockFree = false>
+class RawSkipListBackend
+{
+public:
+    typedef Node<Key, Value> NodeType;
+
+    RawSkipListBackend(NodeType * head, const skiplist_raw_config & config) : head(head)
+    {
+        NodeBase::installTowerAllocator();
+        skiplist_init(&sl, compareNodes);
+        skiplist_set_config(&sl, config);
+        sl.aux = this;
+        if (LockFree) {
+            skiplist_lf_insert(&sl, &head->snode);
+        } else {
+            skiplist_insert(&sl, &head->snode);
+        }
+    }
+
+    void insert(NodeType * node)
+    {
+        if (LockFree) {
+            skiplist_lf_insert(&sl, &node->snode);
+        } else {
+            skiplist_insert(&sl, &node->snode);
+        }
+    }
+
+    void erase(NodeType * node)
+    {
+        if (LockFree) {
+            skiplist_lf_erase_node(&sl, &node->snode);
+        } else {
+            skiplist_erase_node(&sl, &node->snode);
+        }
+    }
+
+    NodeType * findSmaller(const Key & k)
+    {
+        NodeType query(k, Value(), 0);
+        skiplist_node * cursor = LockFree ?
+                                 skiplist_lf_find_smaller(&sl, &query.snode) :
+                                 skiplist_find_smaller_or_equal_optimistic(&sl, &query.snode);
+        return cursor != NULL && cursor != &head->snode ? NodeType::fromIndex(cursor) : NULL;
+    }
+
+    size_t chooseTopLayer()
+    {
+        return skiplist_choose_top_layer(&sl);
+    }
+
+    skiplist_raw_config getConfig()
+    {
+        return skiplist_get_config(&sl);
+    }
+
+    Compare compare;
+
+private:
+    // skiplist_cmp_t; aux is the backend.
+    static int compareNodes(skiplist_node * a, skiplist_node * b, void * aux)
+    {
+        RawSkipListBackend * backend = static_cast<RawSkipListBackend *>(aux);
+        if (a == &backend->head->snode) {
+            return -1;
+        }
+        if (b == &backend->head->snode) {
+            return 1;
+        }
+
+        const Key & aa = NodeType::fromIndex(a)->key;
+        const Key & bb = NodeType::fromIndex(b)->key;
+        if (backend->compare(aa, bb)) {
+            return -1;
+        }
+        if (backend->compare(bb, aa)) {
+            return 1;
+        }
+        return 0;
+    }
+
+    NodeType * head;
+    skiplist_raw sl;
+};
+
+// A KeySkipList, whose entries keep a copy of the key next to their links.
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+class KeySkipListBackend
+{
+public:
+    typedef Node<Key, Value> NodeType;
+
+    KeySkipListBackend(NodeType *, const skiplist_raw_config & config) : keys(config) {}
+
+    void insert(NodeType * node)
+    {
+        keys.insert(node->key, node);
+    }
+
+    void erase(NodeType * node)
+    {
+        keys.erase(node->key, node);
+    }
+
+    NodeType * findSmaller(const Key & k)
+    {
+        return static_cast<NodeType *>(keys.findSmaller(k));
+    }
+
+    size_t chooseTopLayer()
+    {
+        // The index allocates its own entries.
+        return NodeBase::NO_TOWER;
+    }
+
+    skiplist_raw_config getConfig()
+    {
+        return keys.getConfig();
+    }
+
+private:
+    KeySkipList<Key, Compare> keys;
+};
+
+// An OLCBTree, which keeps keys and nodes in sorted arrays of whole pages.
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+class BTreeBackend
+{
+public:
+    typedef Node<Key, Value> NodeType;
+
+    // A B+-tree has no skiplist shape; config is only handed back.
+    BTreeBackend(NodeType *, const skiplist_raw_config & config) : config(config) {}
+
+    void insert(NodeType * node)
+    {
+        tree.insert(node->key, node);
+    }
+
+    void erase(NodeType * node)
+    {
+        tree.erase(node->key, node);
+    }
+
+    NodeType * findSmaller(const Key & k)
+    {
+        return static_cast<NodeType *>(tree.findSmaller(k));
+    }
+
+    size_t chooseTopLayer()
+    {
+        // Nodes need no tower.
+        return NodeBase::NO_TOWER;
+    }
+
+    skiplist_raw_config getConfig()
+    {
+        return config;
+    }
+
+private:
+    OLCBTree<Key, Compare> tree;
+    skiplist_raw_config config;
+};
+
+// The backend of Index and SkipList unless one is given, chosen at compile
+// time:
+// - by default, the lock-based raw skiplist;
+// - with TDSL_LOCKFREE_INDEX, its lock-free variant;
+// - with TDSL_KEY_INDEX, a KeySkipList;
+// - with TDSL_BTREE_INDEX, an OLCBTree.
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+#if defined(TDSL_BTREE_INDEX)
+using DefaultIndexBackend = BTreeBackend<Key, Value, Compare>;
+#elif defined(TDSL_KEY_INDEX)
+using DefaultIndexBackend = KeySkipListBackend<Key, Value, Compare>;
+#elif defined(TDSL_LOCKFREE_INDEX)
+using DefaultIndexBackend = RawSkipListBackend<Key, Value, Compare, true>;
+#else
+using DefaultIndexBackend = RawSkipListBackend<Key, Value, Compare>;
+#endif
@@ -0,0 +1,363 @@
+#pragma once
+
+#include "Utils.h"
+#include "Epoch.h"
+#include "Node.h"
+#include "SlabAllocator.h"
+#include "skiplist/skiplist.h"
+
+#include <functional>
+#include <random>
+
+// Rounds small sizes up to a power of two and larger ones to cache lines, so
+// that no block smaller than a line straddles two.
+constexpr size_t lineFriendly(size_t size, size_t block = 1)
+{
+    return size > CACHE_LINE_SIZE ? cacheLineAligned(size) :
+           block >= size ? block : lineFriendly(size, block << 1);
+}
+
+// A lock-free skiplist of (key, node) pairs for indexing a SkipList.
+//
+// Every entry keeps a copy of its key right before its tower, and the
+// comparator is a template parameter: a search step reads one entry, which
+// for small keys and low layers is a single cache line, and makes no
+// indirect call. Links are marked like those of skiplist_lf_*. Pairs are
+// ordered by key, then by node address, so a key may be indexed for several
+// nodes at once.
+//
+// Entries are allocated from per-thread slabs and retired through Epoch once
+// erased, so every operation must run in an Epoch critical region. The same
+// pair must not be inserted and erased concurrently.
+template <typename Key, typename Compare = std::less<Key>>
+class KeySkipList
+{
+public:
+    // Only the shape of config is used: fanout, maxLayer and layerLimit,
+    // clamped as by skiplist_set_config.
+    KeySkipList(const skiplist_raw_config & config = skiplist_get_default_config());
+
+    ~KeySkipList();
+
+    void insert(const Key & k, NodeBase * node);
+
+    // Returns false if the pair is not in the list.
+    bool erase(const Key & k, NodeBase * node);
+
+    // The node of the last pair with a key smaller than k, or NULL.
+    NodeBase * findSmaller(const Key & k) const;
+
+    size_t size() const
+    {
+        return numEntries.load(std::memory_order_relaxed);
+    }
+
+    skiplist_raw_config getConfig() const;
+
+    Compare compare;
+
+private:
+    class Entry
+    {
+    public:
+        Entry(const Key & k, NodeBase * node, size_t height) :
+            key(k), node(node), height((uint8_t)height)
+        {
+            for (size_t i = 0; i < height; i++) {
+                new (&next[i]) std::atomic<Entry *>(NULL);
+            }
+        }
+
+        Key key;
+        NodeBase * node;
+        uint8_t height;
+        // height links; the entry is allocated with room for all of them.
+        std::atomic<Entry *> next[1];
+    };
+
+    template <size_t Pointers>
+    using EntryAllocator = SlabAllocator<lineFriendly(
+                               sizeof(Entry) + (Pointers - 1) * sizeof(std::atomic<Entry *>))>;
+
+    static Entry * createEntry(const Key & k, NodeBase * node, size_t height);
+
+    static void destroyEntry(Entry * entry);
+
+    // Epoch::Reclaimer for erased entries.
+    static void reclaim(void * entry)
+    {
+        destroyEntry(static_cast<Entry *>(entry));
+    }
+
+    static Entry * marked(Entry * link)
+    {
+        return reinterpret_cast<Entry *>(reinterpret_cast<uintptr_t>(link) | 1);
+    }
+
+    static Entry * unmarked(Entry * link)
+    {
+        return reinterpret_cast<Entry *>(reinterpret_cast<uintptr_t>(link) & ~(uintptr_t)1);
+    }
+
+    static bool isMarked(Entry * link)
+    {
+        return (reinterpret_cast<uintptr_t>(link) & 1) != 0;
+    }
+
+    // Whether entry orders before (k, node).
+    bool before(const Entry * entry, const Key & k, const NodeBase * node) const
+    {
+        if (compare(entry->key, k)) {
+            return true;
+        }
+        return !compare(k, entry->key) && std::less<const NodeBase *>()(entry->node, node);
+    }
+
+    // Fills preds/succs around (k, node) for layers 0 ~ top, unlinking every
+    // marked entry on the way. Returns the entry of the pair, or NULL.
+    Entry * find(const Key & k, const NodeBase * node, size_t top,
+                 Entry ** preds, Entry ** succs);
+
+    size_t searchTop(size_t height) const;
+
+    size_t randomHeight();
+
+    void countInsert();
+
+    Entry * head;
+    size_t fanout;
+    size_t layerLimit;
+    std::atomic<size_t> maxLayer;
+    std::atomic<size_t> growAt;
+    std::atomic<size_t> numEntries;
+};
+
+template <typename Key, typename Compare>
+KeySkipList<Key, Compare>::KeySkipList(const skiplist_raw_config & config) :
+    numEntries(0)
+{
+    size_t layers = std::max<size_t>(config.maxLayer, 1);
+    layers = std::min<size_t>(layers, SKIPLIST_MAX_LAYER - 1);
+    layerLimit = std::max<size_t>(config.layerLimit, layers);
+    layerLimit = std::min<size_t>(layerLimit, SKIPLIST_MAX_LAYER - 1);
+    fanout = std::max<size_t>(config.fanout, 2);
+    maxLayer = layers;
+
+    size_t capacity = 1;
+    for (size_t i = 0; i < layers && capacity < SIZE_MAX / fanout; i++) {
+        capacity *= fanout;
+    }
+    growAt = capacity;
+
+    head = createEntry(Key(), NULL, layerLimit);
+}
+
+template <typename Key, typename Compare>
+KeySkipList<Key, Compare>::~KeySkipList()
+{
+    Entry * entry = head;
+    while (entry != NULL) {
+        Entry * next = unmarked(entry->next[0].load());
+        destroyEntry(entry);
+        entry = next;
+    }
+}
+
+template <typename Key, typename Compare>
+typename KeySkipList<Key, Compare>::Entry * KeySkipList<Key, Compare>::createEntry(
+    const Key & k, NodeBase * node, size_t height)
+{
+    void * block;
+    switch (NodeBase::towerClass(height)) {
+    case 1: block = EntryAllocator<1>::allocate(); break;
+    case 2: block = EntryAllocator<2>::allocate(); break;
+    case 4: block = EntryAllocator<4>::allocate(); break;
+    case 8: block = EntryAllocator<8>::allocate(); break;
+    case 16: block = EntryAllocator<16>::allocate(); break;
+    case 32: block = EntryAllocator<32>::allocate(); break;
+    default: block = EntryAllocator<64>::allocate(); break;
+    }
+    return new (block) Entry(k, node, height);
+}
+
+template <typename Key, typename Compare>
+void KeySkipList<Key, Compare>::destroyEntry(Entry * entry)
+{
+    const size_t pointers = NodeBase::towerClass(entry->height);
+    entry->~Entry();
+    switch (pointers) {
+    case 1: EntryAllocator<1>::release(entry); break;
+    case 2: EntryAllocator<2>::release(entry); break;
+    case 4: EntryAllocator<4>::release(entry); break;
+    case 8: EntryAllocator<8>::release(entry); break;
+    case 16: EntryAllocator<16>::release(entry); break;
+    case 32: EntryAllocator<32>::release(entry); break;
+    default: EntryAllocator<64>::release(entry); break;
+    }
+}
+
+template <typename Key, typename Compare>
+typename KeySkipList<Key, Compare>::Entry * KeySkipList<Key, Compare>::find(
+    const Key & k, const NodeBase * node, size_t top, Entry ** preds, Entry ** succs)
+{
+retry:
+    Entry * pred = head;
+    for (size_t layer = top + 1; layer-- > 0;) {
+        Entry * cur = unmarked(pred->next[layer].load(std::memory_order_acquire));
+        while (cur != NULL) {
+            Entry * next = cur->next[layer].load(std::memory_order_acquire);
+            if (isMarked(next)) {
+                Entry * expected = cur;
+                if (!pred->next[layer].compare_exchange_strong(expected, unmarked(next))) {
+                    goto retry;
+                }
+                cur = unmarked(next);
+                continue;
+            }
+            if (!before(cur, k, node)) {
+                break;
+            }
+            pred = cur;
+            cur = next;
+        }
+        preds[layer] = pred;
+        succs[layer] = cur;
+    }
+
+    Entry * entry = succs[0];
+    return entry != NULL && entry->node == node ? entry : NULL;
+}
+
+template <typename Key, typename Compare>
+size_t KeySkipList<Key, Compare>::searchTop(size_t height) const
+{
+    return std::max(height, maxLayer.load(std::memory_order_relaxed)) - 1;
+}
+
+template <typename Key, typename Compare>
+size_t KeySkipList<Key, Compare>::randomHeight()
+{
+    static thread_local std::minstd_rand generator(
+        (unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const size_t layers = maxLayer.load(std::memory_order_relaxed);
+    size_t height = 1;
+    while (height < layers && generator() % fanout == 0) {
+        height++;
+    }
+    return height;
+}
+
+template <typename Key, typename Compare>
+void KeySkipList<Key, Compare>::countInsert()
+{
+    // Like the raw skiplist: one more layer whenever the size reaches
+    // fanout^maxLayer.
+    const size_t entries = numEntries.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t threshold = growAt.load(std::memory_order_relaxed);
+    if (entries < threshold || maxLayer.load() >= layerLimit) {
+        return;
+    }
+    const size_t next = threshold < SIZE_MAX / fanout ? threshold * fanout : SIZE_MAX;
+    if (growAt.compare_exchange_strong(threshold, next)) {
+        maxLayer.fetch_add(1);
+    }
+}
+
+template <typename Key, typename Compare>
+void KeySkipList<Key, Compare>::insert(const Key & k, NodeBase * node)
+{
+    const size_t height = randomHeight();
+    const size_t top = searchTop(height);
+    Entry * entry = createEntry(k, node, height);
+
+    Entry * preds[SKIPLIST_MAX_LAYER];
+    Entry * succs[SKIPLIST_MAX_LAYER];
+    do {
+        find(k, node, top, preds, succs);
+        for (size_t layer = 0; layer < height; layer++) {
+            entry->next[layer].store(succs[layer], std::memory_order_relaxed);
+        }
+        // Linked at the bottom: the pair is in the list.
+    } while (!preds[0]->next[0].compare_exchange_strong(succs[0], entry));
+
+    for (size_t layer = 1; layer < height; layer++) {
+        for (;;) {
+            Entry * expected = succs[layer];
+            if (preds[layer]->next[layer].compare_exchange_strong(expected, entry)) {
+                break;
+            }
+            find(k, node, top, preds, succs);
+            Entry * link = entry->next[layer].load();
+            if (isMarked(link) || !entry->next[layer].compare_exchange_strong(link, succs[layer])) {
+                // Erased meanwhile: leave the upper layers alone.
+                countInsert();
+                return;
+            }
+        }
+    }
+    countInsert();
+}
+
+template <typename Key, typename Compare>
+bool KeySkipList<Key, Compare>::erase(const Key & k, NodeBase * node)
+{
+    Entry * preds[SKIPLIST_MAX_LAYER];
+    Entry * succs[SKIPLIST_MAX_LAYER];
+    const size_t top = searchTop(1);
+    Entry * entry = find(k, node, top, preds, succs);
+    if (entry == NULL) {
+        return false;
+    }
+
+    for (size_t layer = entry->height - 1; layer > 0; layer--) {
+        Entry * next = entry->next[layer].load();
+        while (!isMarked(next) &&
+                !entry->next[layer].compare_exchange_weak(next, marked(next))) {
+        }
+    }
+
+    // Whoever marks the bottom link erases the pair.
+    Entry * next = entry->next[0].load();
+    do {
+        if (isMarked(next)) {
+            return false;
+        }
+    } while (!entry->next[0].compare_exchange_strong(next, marked(next)));
+
+    // Unlinks it from every layer before it can be retired.
+    find(k, node, searchTop(entry->height), preds, succs);
+    numEntries.fetch_sub(1, std::memory_order_relaxed);
+    Epoch::retire(entry, reclaim);
+    return true;
+}
+
+template <typename Key, typename Compare>
+NodeBase * KeySkipList<Key, Compare>::findSmaller(const Key & k) const
+{
+    const Entry * pred = head;
+    for (size_t layer = maxLayer.load(std::memory_order_relaxed); layer-- > 0;) {
+        Entry * cur = unmarked(pred->next[layer].load(std::memory_order_acquire));
+        while (cur != NULL) {
+            Entry * next = cur->next[layer].load(std::memory_order_acquire);
+            // Skip erased entries without helping to unlink them.
+            if (!isMarked(next)) {
+                if (!compare(cur->key, k)) {
+                    break;
+                }
+                pred = cur;
+            }
+            cur = unmarked(next);
+        }
+    }
+    return pred->node;
+}
+
+template <typename Key, typename Compare>
+skiplist_raw_config KeySkipList<Key, Compare>::getConfig() const
+{
+    skiplist_raw_config config = skiplist_get_default_config();
+    config.fanout = fanout;
+    config.maxLayer = maxLayer.load();
+    config.layerLimit = layerLimit;
+    return config;
+}
@@ -0,0 +1,56 @@
+#include "Node.h"
+
+#include <cstring>
+
+constexpr size_t NodeBase::MAX_INLINE_TOWER;
+constexpr size_t NodeBase::NO_TOWER;
+
+// Towers the index allocates itself (for the sentinels and nodes created
+// without an inline one) come from one slab allocator per size class up to
+// 16 pointers; taller towers fall back to calloc.
+
+template <size_t Pointers>
+static void * allocateTower()
+{
+    return SlabAllocator<Pointers * sizeof(atm_node_ptr)>::allocate();
+}
+
+template <size_t Pointers>
+static void releaseTower(void * tower)
+{
+    SlabAllocator<Pointers * sizeof(atm_node_ptr)>::release(tower);
+}
+
+static atm_node_ptr * allocateSlabTower(size_t count)
+{
+    size_t size = NodeBase::towerClass(count);
+    void * tower;
+    switch (size) {
+    case 1: tower = allocateTower<1>(); break;
+    case 2: tower = allocateTower<2>(); break;
+    case 4: tower = allocateTower<4>(); break;
+    case 8: tower = allocateTower<8>(); break;
+    case 16: tower = allocateTower<16>(); break;
+    default:
+        return static_cast<atm_node_ptr *>(calloc(count, sizeof(atm_node_ptr)));
+    }
+    memset(tower, 0, size * sizeof(atm_node_ptr));
+    return static_cast<atm_node_ptr *>(tower);
+}
+
+static void freeSlabTower(atm_node_ptr * tower, size_t count)
+{
+    switch (NodeBase::towerClass(count)) {
+    case 1: releaseTower<1>(tower); break;
+    case 2: releaseTower<2>(tower); break;
+    case 4: releaseTower<4>(tower); break;
+    case 8: releaseTower<8>(tower); break;
+    case 16: releaseTower<16>(tower); break;
+    default: free(tower); break;
+    }
+}
+
+void NodeBase::installTowerAllocator()
+{
+    skiplist_set_tower_allocator(allocateSlabTower, freeSlabTower);
+}
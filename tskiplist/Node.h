@@ -1,29 +1,154 @@
 #pragma once
 
 #include "Utils.h"
-#include "Mutex.h"
+#include "VersionedLock.h"
+#include "SlabAllocator.h"
 #include "skiplist/skiplist.h"
 
-class Node
+#include <cstring>
+#include <cstdint>
+
+// The key-independent part of a node: everything the write set, the locks
+// and the epoch reclamation work on. Transactions only hold NodeBase
+// pointers, so one transaction type serves every SkipList instantiation.
+// NodeBase has no virtual methods, which would cost every node a vtable
+// pointer: whoever frees nodes knows their Node type (see TDS::destroyNode).
+class NodeBase
 {
 public:
-    Node(const ItemType & k, unsigned int version) :
-        key(k), deleted(false), version(version), next(NULL)
+    NodeBase(VersionType version) :
+        next(NULL), deleted(false), indexed(false), lock(version)
     {
         skiplist_init_node(&snode);
     }
 
-    virtual ~Node() = default;
+    // Makes the raw skiplist allocate node towers from per-thread slabs.
+    static void installTowerAllocator();
+
+    // Towers are rounded up to a power-of-two number of pointers; nodes keep
+    // towers of up to MAX_INLINE_TOWER pointers inline.
+    static constexpr size_t MAX_INLINE_TOWER = 16;
+
+    // The topLayer of a node created without an inline tower.
+    static constexpr size_t NO_TOWER = SIZE_MAX;
+
+    static size_t towerClass(size_t count)
+    {
+        size_t size = 1;
+        while (size < count) {
+            size <<= 1;
+        }
+        return size;
+    }
 
     bool isLocked()
     {
         return lock.isLocked();
     }
 
+    VersionType getVersion()
+    {
+        return VersionedLock::getVersion(lock.load());
+    }
+
     skiplist_node snode;
-    ItemType key;
-    Node * next;
+    NodeBase * next;
     bool deleted;
-    Mutex lock;
-    unsigned int version;
-};
\ No newline at end of file
+    // Set once the node's INSERT was applied to (or skipped by) the Index.
+    std::atomic<bool> indexed;
+    VersionedLock lock;
+};
+
+template <typename Key, typename Value>
+class Node;
+
+// A node together with an inline tower of Pointers index pointers. Blocks
+// are packed rather than padded to cache lines: most nodes have a single
+// layer, and padding them would double the memory footprint of the list.
+template <typename Key, typename Value, size_t Pointers = 0>
+using NodeAllocator = SlabAllocator<roundUp(
+                          sizeof(Node<Key, Value>) + Pointers * sizeof(atm_node_ptr),
+                          alignof(Node<Key, Value>))>;
+
+template <typename Key, typename Value>
+class Node : public NodeBase
+{
+public:
+    Node(const Key & k, const Value & v, VersionType version) :
+        NodeBase(version), key(k), value(v) {}
+
+    // Allocates from the calling thread's node slabs. A node that gets a
+    // topLayer (see Index::chooseTopLayer) has its index tower right behind
+    // it, so index traversals find a node's forward pointers in the same
+    // block instead of chasing a separate allocation. With NO_TOWER, or if
+    // the tower is too tall, the index allocates the tower on insert, if it
+    // needs one.
+    static Node * create(const Key & k, const Value & v, VersionType version,
+                         size_t topLayer = NO_TOWER)
+    {
+        const size_t pointers = topLayer != NO_TOWER && topLayer < MAX_INLINE_TOWER ?
+                                towerClass(topLayer + 1) : 0;
+        Node * node = new (allocate(pointers)) Node(k, v, version);
+        if (pointers != 0) {
+            atm_node_ptr * tower = reinterpret_cast<atm_node_ptr *>(node + 1);
+            memset(tower, 0, pointers * sizeof(atm_node_ptr));
+            skiplist_init_node_with_tower(&node->snode, tower, topLayer);
+        }
+        return node;
+    }
+
+    static Node * fromIndex(skiplist_node * snode)
+    {
+        return static_cast<Node *>(_get_entry(snode, NodeBase, snode));
+    }
+
+    // Frees the node's skiplist tower and returns both to the calling
+    // thread's slabs. Only for nodes no other thread can reach (see
+    // Epoch::retire).
+    void destroy()
+    {
+        const size_t pointers = snode.fixed_tower ? towerClass(snode.top_layer + 1) : 0;
+        skiplist_free_node(&snode);
+        this->~Node();
+        release(this, pointers);
+    }
+
+    // Epoch::Reclaimer for retired nodes.
+    static void reclaim(void * node)
+    {
+        static_cast<Node *>(node)->destroy();
+    }
+
+    Node * getNext()
+    {
+        return static_cast<Node *>(next);
+    }
+
+    Key key;
+    Value value;
+
+private:
+    static void * allocate(size_t pointers)
+    {
+        switch (pointers) {
+        case 1: return NodeAllocator<Key, Value, 1>::allocate();
+        case 2: return NodeAllocator<Key, Value, 2>::allocate();
+        case 4: return NodeAllocator<Key, Value, 4>::allocate();
+        case 8: return NodeAllocator<Key, Value, 8>::allocate();
+        case 16: return NodeAllocator<Key, Value, 16>::allocate();
+        default: return NodeAllocator<Key, Value>::allocate();
+        }
+    }
+
+    static void release(void * block, size_t pointers)
+    {
+        switch (pointers) {
+        case 1: NodeAllocator<Key, Value, 1>::release(block); break;
+        case 2: NodeAllocator<Key, Value, 2>::release(block); break;
+        case 4: NodeAllocator<Key, Value, 4>::release(block); break;
+        case 8: NodeAllocator<Key, Value, 8>::release(block); break;
+        case 16: NodeAllocator<Key, Value, 16>::release(block); break;
+        default: NodeAllocator<Key, Value>::release(block); break;
+        }
+    }
+};
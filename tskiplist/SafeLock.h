@@ -1,11 +1,12 @@
 #pragma once
 
 #include "Utils.h"
+#include "VersionedLock.h"
 
 class SafeLock
 {
 public:
-    SafeLock(Mutex & m) : lock(m)
+    SafeLock(VersionedLock & m) : lock(m)
     {
         lock.lock();
     }
@@ -16,7 +17,7 @@ public:
     }
 
 private:
-    Mutex & lock;
+    VersionedLock & lock;
 };
 
 class SafeLockList
@@ -32,11 +33,18 @@ public:
         }
     }
 
-    void add(Mutex & lock)
+    void add(VersionedLock & lock)
     {
         locks.push_back(&lock);
     }
 
+    // Forget the held locks once they were released by a version-bumping
+    // store (see WriteSet::update).
+    void dismiss()
+    {
+        locks.clear();
+    }
+
 private:
-    std::vector<Mutex *> locks;
-};
\ No newline at end of file
+    std::vector<VersionedLock *> locks;
+};
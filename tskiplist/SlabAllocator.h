@@ -0,0 +1,185 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// Per-thread slab allocator for blocks of BlockSize bytes.
+//
+// Every thread carves blocks out of its own cache-line-aligned slabs and
+// recycles released blocks through a private free list, so allocation and
+// release take no lock. A thread that releases more than it allocates (e.g.
+// an index maintainer reclaiming nodes) hands batches of free blocks to a
+// shared depot, which allocating threads drain before carving new slabs.
+// Slabs are never returned to the system.
+template <size_t BlockSize>
+class SlabAllocator
+{
+public:
+    static void * allocate()
+    {
+        LocalCache & cache = localCache();
+        if (!cache.head) {
+            refill(cache);
+        }
+
+        FreeBlock * block = cache.head;
+        cache.head = block->next;
+        cache.count--;
+        return block;
+    }
+
+    static void release(void * memory)
+    {
+        LocalCache & cache = localCache();
+        FreeBlock * block = static_cast<FreeBlock *>(memory);
+        block->next = cache.head;
+        cache.head = block;
+
+        if (++cache.count >= 2 * BATCH_SIZE) {
+            depot().push(cache.take(BATCH_SIZE));
+        }
+    }
+
+private:
+    static_assert(BlockSize >= sizeof(void *), "Blocks must hold a pointer");
+
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t BATCH_SIZE = 256;
+
+    class FreeBlock
+    {
+    public:
+        FreeBlock * next;
+    };
+
+    class Batch
+    {
+    public:
+        Batch() : head(NULL), count(0) {}
+
+        FreeBlock * head;
+        size_t count;
+    };
+
+    class Depot
+    {
+    public:
+        void push(Batch batch)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            batches.push_back(batch);
+        }
+
+        bool pop(Batch & batch)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (batches.empty()) {
+                return false;
+            }
+            batch = batches.back();
+            batches.pop_back();
+            return true;
+        }
+
+    private:
+        std::mutex mutex;
+        std::vector<Batch> batches;
+    };
+
+    class LocalCache
+    {
+    public:
+        LocalCache() : head(NULL), count(0) {}
+
+        ~LocalCache()
+        {
+            if (head) {
+                depot().push(take(count));
+            }
+        }
+
+        Batch take(size_t n)
+        {
+            Batch batch;
+            while (batch.count < n && head) {
+                FreeBlock * block = head;
+                head = block->next;
+                block->next = batch.head;
+                batch.head = block;
+                batch.count++;
+            }
+            count -= batch.count;
+            return batch;
+        }
+
+        FreeBlock * head;
+        size_t count;
+    };
+
+    static LocalCache & localCache()
+    {
+        static thread_local LocalCache cache;
+        return cache;
+    }
+
+    static Depot & depot()
+    {
+        static Depot instance;
+        return instance;
+    }
+
+    static void refill(LocalCache & cache)
+    {
+        Batch batch;
+        if (depot().pop(batch)) {
+            cache.head = batch.head;
+            cache.count = batch.count;
+            return;
+        }
+
+        // Link the blocks so that they are handed out in address order.
+        char * slab = static_cast<char *>(allocateSlab());
+        for (size_t i = SLAB_SIZE / BlockSize; i > 0; i--) {
+            FreeBlock * block = reinterpret_cast<FreeBlock *>(slab + (i - 1) * BlockSize);
+            block->next = cache.head;
+            cache.head = block;
+            cache.count++;
+        }
+    }
+
+    static void * allocateSlab()
+    {
+        void * slab = NULL;
+#ifdef _WIN32
+        slab = _aligned_malloc(SLAB_SIZE, CACHE_LINE_SIZE);
+#else
+        if (posix_memalign(&slab, CACHE_LINE_SIZE, SLAB_SIZE) != 0) {
+            slab = NULL;
+        }
+#endif
+        if (!slab) {
+            throw std::bad_alloc();
+        }
+        return slab;
+    }
+};
+
+// Rounds size up to a multiple of alignment.
+constexpr size_t roundUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Rounds size up to a whole number of cache lines.
+constexpr size_t cacheLineAligned(size_t size)
+{
+    return roundUp(size, CACHE_LINE_SIZE);
+}
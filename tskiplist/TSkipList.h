@@ -1,51 +1,1007 @@
 #pragma once
 
 #include "Utils.h"
-#include "WriteSet.h"
 #include "Node.h"
 #include "GVC.h"
 #include "Index.h"
+#include "Transaction.h"
+#include "ContentionManager.h"
 
+#include <functional>
 
-class SkipListTransaction
+inline OpResult toOpResult(bool value)
 {
-public:
-    SkipListTransaction() {}
-
-    virtual ~SkipListTransaction() {}
+    return value ? OP_TRUE : OP_FALSE;
+}
 
-    unsigned int readVersion;
-    unsigned int writeVersion;
-    std::vector<Node *> readSet;
-    WriteSet writeSet;
-    std::vector<IndexOperation> indexTodo;
-};
+inline bool fromOpResult(OpResult result)
+{
+    if (result == OP_ABORTED) {
+        throw AbortTransactionException();
+    }
+    return result == OP_TRUE;
+}
 
-class SkipList
+// A transactional ordered map. Compare must be a strict weak ordering; keys
+// are equal when neither orders before the other. Values are fixed when a
+// key is inserted.
+//
+// SkipLists constructed on the same GVC can be used by one Transaction.
+template <typename Key = ItemType, typename Value = ItemType,
+          typename Compare = std::less<Key>,
+          typename Backend = DefaultIndexBackend<Key, Value, Compare>>
+class SkipList : public TDS
 {
+    // Set when the SkipList has a clock of its own; initialized before gvc.
+    std::unique_ptr<GVC> ownClock;
+
 public:
-    SkipList() : index(gvc.read()) {}
+    typedef Node<Key, Value> NodeType;
+
+    // Walks the keys of a transaction in order, starting at the key passed to
+    // seek(). Every step is validated like a point read, so a conflict raises
+    // AbortTransactionException (next) or marks the transaction aborted
+    // (tryNext); either leaves the iterator past the end. Stepping past the
+    // end raises std::logic_error. Only valid while the transaction is
+    // running.
+    class Iterator
+    {
+    public:
+        Iterator() : list(NULL), transaction(NULL), node(NULL) {}
+
+        bool valid() const
+        {
+            return node != NULL;
+        }
+
+        const Key & key() const
+        {
+            return node->key;
+        }
+
+        const Value & value() const
+        {
+            return node->value;
+        }
+
+        void next()
+        {
+            if (!tryNext()) {
+                throw AbortTransactionException();
+            }
+        }
+
+        bool tryNext()
+        {
+            if (!valid()) {
+                throw std::logic_error("Iterator is past the end!");
+            }
+            return list->tryStep(*transaction, node);
+        }
+
+    private:
+        friend class SkipList;
+
+        SkipList * list;
+        SkipListTransaction * transaction;
+        NodeType * node;
+    };
+
+    // indexConfig shapes the index skiplist (see skiplist_raw_config).
+    SkipList(GVCMode gvcMode = GV1,
+             const skiplist_raw_config & indexConfig = skiplist_get_default_config()) :
+        TDS(NodeType::reclaim), ownClock(new GVC(gvcMode)), gvc(*ownClock),
+        index(gvc.read(), indexConfig) {}
+
+    SkipList(GVC & clock,
+             const skiplist_raw_config & indexConfig = skiplist_get_default_config()) :
+        TDS(NodeType::reclaim), gvc(clock), index(gvc.read(), indexConfig) {}
 
     virtual ~SkipList() {}
 
-    void TXBegin(SkipListTransaction & transaction);
+    void onCommit(std::vector<IndexOperation> & ops) override
+    {
+        index.update(ops);
+    }
 
-    bool contains(const ItemType & k, SkipListTransaction & transaction);
+    void TXBegin(SkipListTransaction & transaction,
+                 TransactionType type = TX_READ_WRITE);
 
-    bool insert(const ItemType & k, SkipListTransaction & transaction);
+    // Abort counts by cause. These are process-wide, not per list: aborts
+    // belong to transactions, which may span several SkipLists, so the
+    // counts are summed over all threads and every SkipList (and reset for
+    // all of them) whichever list is asked; see AbortStats.
+    static AbortStats abortStats()
+    {
+        return AbortStats::collect();
+    }
 
-    bool remove(const ItemType & k, SkipListTransaction & transaction);
+    static void resetAbortStats()
+    {
+        AbortStats::reset();
+    }
 
-    Node * getValidatedValue(SkipListTransaction & transaction, Node * node,
-                             bool * outDeleted = NULL);
+    // Runs fn(transaction) until it commits; see ::atomically.
+    template <typename Fn>
+    unsigned int atomically(Fn fn, const RetryPolicy & policy = RetryPolicy(),
+                            TransactionType type = TX_READ_WRITE)
+    {
+        return ::atomically(gvc, fn, policy, type);
+    }
 
-    bool validateReadSet(SkipListTransaction & transaction);
+    // The throwing API: conflicts raise AbortTransactionException.
+    bool contains(const Key & k, SkipListTransaction & transaction);
+
+    bool get(const Key & k, Value & v, SkipListTransaction & transaction);
+
+    bool insert(const Key & k, SkipListTransaction & transaction);
+
+    bool insert(const Key & k, const Value & v,
+                SkipListTransaction & transaction);
+
+    bool remove(const Key & k, SkipListTransaction & transaction);
+
+    // Calls fn(key, value) for every key in [lo, hi], in order. Returns
+    // whether the range held any key.
+    template <typename Callback>
+    bool scan(const Key & lo, const Key & hi, Callback fn,
+              SkipListTransaction & transaction);
+
+    // An iterator positioned at the first key not smaller than k.
+    Iterator seek(const Key & k, SkipListTransaction & transaction);
+
+    // Batch operations over keys sorted by Compare. They merge the keys
+    // against the list in a single walk and return whether the operation
+    // succeeded for every key (containsAll stops at the first missing one).
+    template <typename InputIt>
+    bool containsAll(InputIt first, InputIt last,
+                     SkipListTransaction & transaction);
+
+    template <typename InputIt>
+    bool insertAll(InputIt first, InputIt last,
+                   SkipListTransaction & transaction);
+
+    template <typename InputIt>
+    bool removeAll(InputIt first, InputIt last,
+                   SkipListTransaction & transaction);
+
+    NodeType * getValidatedValue(SkipListTransaction & transaction,
+                                 NodeBase * node, bool * outDeleted = NULL);
 
     void TXCommit(SkipListTransaction & transaction);
 
-    void traverseTo(const ItemType & k, SkipListTransaction & transaction,
-                    Node *& pred, Node *& succ);
+    // Ends an aborted or abandoned transaction without waiting for its
+    // destructor or the next TXBegin.
+    void TXAbort(SkipListTransaction & transaction);
+
+    // Closed nested transactions (see Transaction::beginNested). A conflict
+    // inside the child only costs the child: TXCommitNested rolls it back
+    // and throws AbortTransactionException, after which transaction.aborted
+    // tells whether the parent has to be retried as well.
+    void TXBeginNested(SkipListTransaction & transaction);
+
+    void TXCommitNested(SkipListTransaction & transaction);
+
+    // Rolls the child back; returns whether the parent can go on.
+    bool TXAbortNested(SkipListTransaction & transaction);
+
+    // Singleton operations: each runs on its own, without a transaction, and
+    // is linearizable with concurrent transactions. Reads only wait out
+    // locked nodes; updates lock just pred (and the removed node) and commit
+    // right away.
+    bool singletonContains(const Key & k);
+
+    bool singletonGet(const Key & k, Value & v);
+
+    bool singletonInsert(const Key & k, const Value & v = Value());
+
+    bool singletonRemove(const Key & k);
+
+    void traverseTo(const Key & k, SkipListTransaction & transaction,
+                    NodeType *& pred, NodeType *& succ);
+
+    // The non-throwing API: conflicts mark the transaction as aborted and are
+    // reported through the return value, without unwinding.
+    OpResult tryContains(const Key & k, SkipListTransaction & transaction);
+
+    OpResult tryGet(const Key & k, Value & v,
+                    SkipListTransaction & transaction);
+
+    OpResult tryInsert(const Key & k, SkipListTransaction & transaction);
+
+    OpResult tryInsert(const Key & k, const Value & v,
+                       SkipListTransaction & transaction);
+
+    OpResult tryRemove(const Key & k, SkipListTransaction & transaction);
+
+    // Unsorted keys are still handled correctly, at the cost of an index
+    // search for every key that goes backwards.
+    template <typename InputIt>
+    OpResult tryContainsAll(InputIt first, InputIt last,
+                            SkipListTransaction & transaction);
+
+    // Consecutive new keys are chained to each other before commit, so a run
+    // of inserts between two existing nodes changes a single pred entry.
+    template <typename InputIt>
+    OpResult tryInsertAll(InputIt first, InputIt last,
+                          SkipListTransaction & transaction);
+
+    template <typename InputIt>
+    OpResult tryRemoveAll(InputIt first, InputIt last,
+                          SkipListTransaction & transaction);
+
+    // A scan costs one index lookup plus one validated hop per key; fn only
+    // sees keys of a consistent snapshot, but may already have run when a
+    // later hop aborts the transaction.
+    template <typename Callback>
+    OpResult tryScan(const Key & lo, const Key & hi, Callback fn,
+                     SkipListTransaction & transaction);
+
+    // Returns NULL and sets transaction.aborted on a conflict.
+    NodeType * tryGetValidatedValue(SkipListTransaction & transaction,
+                                    NodeBase * node, bool * outDeleted = NULL);
+
+    bool TXTryCommit(SkipListTransaction & transaction);
+
+    bool TXTryCommitNested(SkipListTransaction & transaction);
 
-    GVC gvc;
-    Index index;
+    bool tryTraverseTo(const Key & k, SkipListTransaction & transaction,
+                       NodeType *& pred, NodeType *& succ);
+
+    bool validateReadSet(SkipListTransaction & transaction);
+
+    GVC & gvc;
+    Index<Key, Value, Compare, Backend> index;
+
+private:
+    // Moves node to its successor in the transaction's view, recording node
+    // in the read set. Returns false on a conflict.
+    bool tryStep(SkipListTransaction & transaction, NodeType *& node);
+
+    // The transaction's finger if a traversal to k may start from it.
+    NodeType * getFinger(SkipListTransaction & transaction, const Key & k);
+
+    // Moves pred and succ forward until succ is the first node not smaller
+    // than k. With mayReseek, a long walk is cut short by an index search.
+    bool tryAdvance(const Key & k, SkipListTransaction & transaction,
+                    NodeType *& pred, NodeType *& succ, bool mayReseek);
+
+    // Positions a batch operation at k: advances from the previous key's
+    // pred, or traverses afresh if k does not follow it.
+    bool tryBatchSeek(const Key & k, SkipListTransaction & transaction,
+                      NodeType *& pred, NodeType *& succ);
+
+    // Finds the last non-deleted node before k through the index.
+    bool trySeekIndex(const Key & k, SkipListTransaction & transaction,
+                      NodeType *& startNode, NodeType *& succ);
+
+    // Finds pred and succ around k for a singleton operation: pred was live
+    // and linked to succ at some point during the call. Must run in an
+    // epoch critical region.
+    void traverseSingleton(const Key & k, NodeType *& pred, NodeType *& succ);
+
+    // Locks pred if it is still live and linked to succ.
+    bool tryLockLink(NodeType * pred, NodeType * succ);
+
+    // Hands the index operation of a singleton update to the index, as a
+    // commit would.
+    void publishSingleton(NodeType * node, OperationType op);
+
+    // Hops a traversal may take from the finger before it searches the
+    // index instead.
+    static constexpr size_t MAX_FINGER_HOPS = 16;
+
+    // Whether succ, as found by tryTraverseTo(k), holds k.
+    bool isMatch(NodeType * succ, const Key & k)
+    {
+        return succ != NULL && !index.compare(k, succ->key);
+    }
 };
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::TXBegin(SkipListTransaction & transaction,
+        TransactionType type)
+{
+    transaction.begin(gvc, type);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::contains(const Key & k,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryContains(k, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::get(const Key & k, Value & v,
+                                        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryGet(k, v, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::insert(const Key & k,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryInsert(k, Value(), transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::insert(const Key & k, const Value & v,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryInsert(k, v, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::remove(const Key & k,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryRemove(k, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename Callback>
+bool SkipList<Key, Value, Compare, Backend>::scan(const Key & lo, const Key & hi,
+        Callback fn, SkipListTransaction & transaction)
+{
+    return fromOpResult(tryScan(lo, hi, fn, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+typename SkipList<Key, Value, Compare, Backend>::Iterator
+SkipList<Key, Value, Compare, Backend>::seek(const Key & k,
+                                    SkipListTransaction & transaction)
+{
+    Iterator it;
+    NodeType * pred = NULL;
+    traverseTo(k, transaction, pred, it.node);
+    it.list = this;
+    it.transaction = &transaction;
+    return it;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename InputIt>
+bool SkipList<Key, Value, Compare, Backend>::containsAll(InputIt first, InputIt last,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryContainsAll(first, last, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename InputIt>
+bool SkipList<Key, Value, Compare, Backend>::insertAll(InputIt first, InputIt last,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryInsertAll(first, last, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename InputIt>
+bool SkipList<Key, Value, Compare, Backend>::removeAll(InputIt first, InputIt last,
+        SkipListTransaction & transaction)
+{
+    return fromOpResult(tryRemoveAll(first, last, transaction));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+typename SkipList<Key, Value, Compare, Backend>::NodeType *
+SkipList<Key, Value, Compare, Backend>::getValidatedValue(
+    SkipListTransaction & transaction, NodeBase * node, bool * outDeleted)
+{
+    NodeType * res = tryGetValidatedValue(transaction, node, outDeleted);
+    if (transaction.aborted) {
+        throw AbortTransactionException();
+    }
+    return res;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::TXCommit(SkipListTransaction & transaction)
+{
+    if (!TXTryCommit(transaction)) {
+        throw AbortTransactionException();
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::TXAbort(SkipListTransaction & transaction)
+{
+    transaction.abort();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::TXBeginNested(SkipListTransaction & transaction)
+{
+    transaction.beginNested();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::TXCommitNested(SkipListTransaction & transaction)
+{
+    if (!TXTryCommitNested(transaction)) {
+        throw AbortTransactionException();
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::TXAbortNested(SkipListTransaction & transaction)
+{
+    return transaction.abortNested();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::singletonContains(const Key & k)
+{
+    EpochGuard guard;
+    NodeType * pred = NULL, *succ = NULL;
+    traverseSingleton(k, pred, succ);
+    return isMatch(succ, k);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::singletonGet(const Key & k, Value & v)
+{
+    EpochGuard guard;
+    NodeType * pred = NULL, *succ = NULL;
+    traverseSingleton(k, pred, succ);
+    if (!isMatch(succ, k)) {
+        return false;
+    }
+    v = succ->value;
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::singletonInsert(const Key & k, const Value & v)
+{
+    EpochGuard guard;
+    NodeType * newNode = NULL;
+    while (newNode == NULL) {
+        NodeType * pred = NULL, *succ = NULL;
+        traverseSingleton(k, pred, succ);
+        if (isMatch(succ, k)) {
+            return false;
+        }
+
+        CommitScope scope;
+        if (!tryLockLink(pred, succ)) {
+            continue;
+        }
+        const VersionType writeVersion = gvc.addAndFetch();
+        newNode = NodeType::create(k, v, writeVersion, index.chooseTopLayer());
+        newNode->next = succ;
+        pred->next = newNode;
+        pred->lock.unlock(writeVersion);
+        gvc.committed(writeVersion);
+    }
+
+    publishSingleton(newNode, OperationType::INSERT);
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::singletonRemove(const Key & k)
+{
+    EpochGuard guard;
+    NodeType * victim = NULL;
+    while (victim == NULL) {
+        NodeType * pred = NULL, *succ = NULL;
+        traverseSingleton(k, pred, succ);
+        if (!isMatch(succ, k)) {
+            return false;
+        }
+
+        CommitScope scope;
+        if (!tryLockLink(pred, succ)) {
+            continue;
+        }
+        // A committer may hold succ to link a node after it.
+        if (!succ->lock.tryLock()) {
+            pred->lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        const VersionType writeVersion = gvc.addAndFetch();
+        succ->deleted = true;
+        pred->next = succ->next;
+        succ->lock.unlock(writeVersion);
+        pred->lock.unlock(writeVersion);
+        gvc.committed(writeVersion);
+        victim = succ;
+    }
+
+    publishSingleton(victim, OperationType::REMOVE);
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::traverseSingleton(const Key & k,
+        NodeType *& pred, NodeType *& succ)
+{
+    // Only removing a node sets its deleted flag, and that also relinks its
+    // pred; so a live pred linked to succ places k between them.
+    pred = index.getPrev(k);
+    for (;;) {
+        const uint64_t lockWord = pred->lock.load();
+        if (VersionedLock::isLocked(lockWord)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const bool deleted = pred->deleted;
+        succ = pred->getNext();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (pred->lock.load() != lockWord) {
+            continue;
+        }
+
+        if (deleted) {
+            pred = index.getPrev(pred->key);
+        } else if (succ != NULL && index.compare(succ->key, k)) {
+            pred = succ;
+        } else {
+            return;
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::tryLockLink(NodeType * pred, NodeType * succ)
+{
+    if (!pred->lock.tryLock()) {
+        std::this_thread::yield();
+        return false;
+    }
+    if (pred->deleted || pred->next != succ) {
+        pred->lock.unlock();
+        return false;
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::publishSingleton(NodeType * node,
+        OperationType op)
+{
+    static thread_local std::vector<IndexOperation> ops;
+    ops.clear();
+    ops.push_back(IndexOperation(node, op));
+    onCommit(ops);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+void SkipList<Key, Value, Compare, Backend>::traverseTo(const Key & k,
+        SkipListTransaction & transaction, NodeType *& pred, NodeType *& succ)
+{
+    if (!tryTraverseTo(k, transaction, pred, succ)) {
+        throw AbortTransactionException();
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+OpResult SkipList<Key, Value, Compare, Backend>::tryContains(const Key & k,
+        SkipListTransaction & transaction)
+{
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(k, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+
+    return toOpResult(isMatch(succ, k));
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+OpResult SkipList<Key, Value, Compare, Backend>::tryGet(const Key & k, Value & v,
+        SkipListTransaction & transaction)
+{
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(k, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+
+    if (!isMatch(succ, k)) {
+        return OP_FALSE;
+    }
+    // Values never change after the insert, so the validated link to succ
+    // covers the value too.
+    v = succ->value;
+    return OP_TRUE;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+OpResult SkipList<Key, Value, Compare, Backend>::tryInsert(const Key & k,
+        SkipListTransaction & transaction)
+{
+    return tryInsert(k, Value(), transaction);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+OpResult SkipList<Key, Value, Compare, Backend>::tryInsert(const Key & k,
+        const Value & v, SkipListTransaction & transaction)
+{
+    if (transaction.type == TX_READ_ONLY) {
+        throw std::runtime_error("Update in a read-only transaction!");
+    }
+
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(k, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+
+    if (isMatch(succ, k)) {
+        return OP_FALSE;
+    }
+
+    NodeType * newNode = NodeType::create(k, v, transaction.readVersion,
+                                          index.chooseTopLayer());
+    newNode->next = succ;
+
+    transaction.writeSet.addItem(pred, newNode, false);
+    transaction.writeSet.addItem(newNode, NULL, false);
+    transaction.enlist(this).push_back(IndexOperation(newNode, OperationType::INSERT));
+    return OP_TRUE;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+OpResult SkipList<Key, Value, Compare, Backend>::tryRemove(const Key & k,
+        SkipListTransaction & transaction)
+{
+    if (transaction.type == TX_READ_ONLY) {
+        throw std::runtime_error("Update in a read-only transaction!");
+    }
+
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(k, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+
+    if (!isMatch(succ, k)) {
+        return OP_FALSE;
+    }
+
+    transaction.readSet.push_back(succ);
+
+    NodeType * next = tryGetValidatedValue(transaction, succ);
+    if (transaction.aborted) {
+        return OP_ABORTED;
+    }
+
+    transaction.writeSet.setNext(pred, next);
+    transaction.writeSet.addItem(succ, NULL, true);
+    transaction.enlist(this).push_back(IndexOperation(succ, OperationType::REMOVE));
+    return OP_TRUE;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename Callback>
+OpResult SkipList<Key, Value, Compare, Backend>::tryScan(const Key & lo, const Key & hi,
+        Callback fn, SkipListTransaction & transaction)
+{
+    NodeType * pred = NULL, *node = NULL;
+    if (!tryTraverseTo(lo, transaction, pred, node)) {
+        return OP_ABORTED;
+    }
+
+    bool found = false;
+    while (node != NULL && !index.compare(hi, node->key)) {
+        fn(node->key, node->value);
+        found = true;
+        if (!tryStep(transaction, node)) {
+            return OP_ABORTED;
+        }
+    }
+    return toOpResult(found);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename InputIt>
+OpResult SkipList<Key, Value, Compare, Backend>::tryContainsAll(InputIt first,
+        InputIt last, SkipListTransaction & transaction)
+{
+    if (first == last) {
+        return OP_TRUE;
+    }
+
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(*first, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+    for (; first != last; ++first) {
+        if (!tryBatchSeek(*first, transaction, pred, succ)) {
+            return OP_ABORTED;
+        }
+        if (!isMatch(succ, *first)) {
+            return OP_FALSE;
+        }
+    }
+    return OP_TRUE;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename InputIt>
+OpResult SkipList<Key, Value, Compare, Backend>::tryInsertAll(InputIt first,
+        InputIt last, SkipListTransaction & transaction)
+{
+    if (transaction.type == TX_READ_ONLY) {
+        throw std::runtime_error("Update in a read-only transaction!");
+    }
+    if (first == last) {
+        return OP_TRUE;
+    }
+
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(*first, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+
+    std::vector<IndexOperation> & indexTodo = transaction.enlist(this);
+    // The node inserted last; nothing else can reach it before the commit,
+    // so the next new node is linked to it directly.
+    NodeType * fresh = NULL;
+    bool all = true;
+    for (; first != last; ++first) {
+        if (!tryBatchSeek(*first, transaction, pred, succ)) {
+            return OP_ABORTED;
+        }
+        if (isMatch(succ, *first)) {
+            all = false;
+            continue;
+        }
+
+        NodeType * newNode = NodeType::create(*first, Value(), transaction.readVersion,
+                                                     index.chooseTopLayer());
+        newNode->next = succ;
+        if (pred == fresh) {
+            fresh->next = newNode;
+        } else {
+            transaction.writeSet.setNext(pred, newNode);
+        }
+        // Committing locks the new node and stamps it with the write version,
+        // as for tryInsert.
+        transaction.writeSet.addItem(newNode, NULL, false);
+        indexTodo.push_back(IndexOperation(newNode, OperationType::INSERT));
+        pred = fresh = newNode;
+    }
+    return toOpResult(all);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+template <typename InputIt>
+OpResult SkipList<Key, Value, Compare, Backend>::tryRemoveAll(InputIt first,
+        InputIt last, SkipListTransaction & transaction)
+{
+    if (transaction.type == TX_READ_ONLY) {
+        throw std::runtime_error("Update in a read-only transaction!");
+    }
+    if (first == last) {
+        return OP_TRUE;
+    }
+
+    NodeType * pred = NULL, *succ = NULL;
+    if (!tryTraverseTo(*first, transaction, pred, succ)) {
+        return OP_ABORTED;
+    }
+
+    std::vector<IndexOperation> & indexTodo = transaction.enlist(this);
+    bool all = true;
+    for (; first != last; ++first) {
+        if (!tryBatchSeek(*first, transaction, pred, succ)) {
+            return OP_ABORTED;
+        }
+        if (!isMatch(succ, *first)) {
+            all = false;
+            continue;
+        }
+
+        transaction.readSet.push_back(succ);
+        NodeType * next = tryGetValidatedValue(transaction, succ);
+        if (transaction.aborted) {
+            return OP_ABORTED;
+        }
+
+        // Adjacent removals keep updating the same pred entry.
+        transaction.writeSet.setNext(pred, next);
+        transaction.writeSet.addItem(succ, NULL, true);
+        indexTodo.push_back(IndexOperation(succ, OperationType::REMOVE));
+        succ = next;
+    }
+    return toOpResult(all);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::tryStep(SkipListTransaction & transaction,
+        NodeType *& node)
+{
+    if (transaction.aborted) {
+        return false;
+    }
+
+    // Committing validates that nothing was linked in after node since.
+    if (transaction.type != TX_READ_ONLY) {
+        transaction.readSet.push_back(node);
+    }
+    node = tryGetValidatedValue(transaction, node);
+    return !transaction.aborted;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+typename SkipList<Key, Value, Compare, Backend>::NodeType *
+SkipList<Key, Value, Compare, Backend>::tryGetValidatedValue(
+    SkipListTransaction & transaction, NodeBase * node, bool * outDeleted)
+{
+    NodeBase * res = NULL;
+    const uint64_t lockWord = node->lock.load();
+    if (VersionedLock::isLocked(lockWord)) {
+        transaction.markAborted(ABORT_LOCKED);
+        return NULL;
+    }
+    // Irrevocable transactions may see versions past readVersion from the
+    // commits they waited for (e.g. under GV5), but no newer ones.
+    if (VersionedLock::getVersion(lockWord) > transaction.readVersion &&
+            transaction.type != TX_IRREVOCABLE) {
+        gvc.onAbort(VersionedLock::getVersion(lockWord));
+        transaction.markAborted(ABORT_NEWER_VERSION);
+        return NULL;
+    }
+
+    if (!transaction.writeSet.getValue(node, res, outDeleted)) {
+        res = node->next;
+
+        if (outDeleted) {
+            *outDeleted = node->deleted;
+        }
+    }
+
+    // The fields read above are consistent only if nobody locked or
+    // committed the node in the meantime.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (node->lock.load() != lockWord) {
+        transaction.markAborted(ABORT_CHANGED_DURING_READ);
+        return NULL;
+    }
+
+    return static_cast<NodeType *>(res);
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::validateReadSet(
+    SkipListTransaction & transaction)
+{
+    return transaction.validateReadSet();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::TXTryCommit(
+    SkipListTransaction & transaction)
+{
+    return transaction.tryCommit();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::TXTryCommitNested(
+    SkipListTransaction & transaction)
+{
+    return transaction.tryCommitNested();
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::tryTraverseTo(const Key & k,
+        SkipListTransaction & transaction, NodeType *& pred, NodeType *& succ)
+{
+    if (transaction.clock != &gvc) {
+        throw std::runtime_error("SkipList does not use the transaction's clock!");
+    }
+    if (transaction.aborted) {
+        return false;
+    }
+
+    NodeType * startNode = getFinger(transaction, k);
+    bool fromFinger = startNode != NULL;
+    bool deleted = false;
+    if (fromFinger) {
+        succ = tryGetValidatedValue(transaction, startNode, &deleted);
+        if (transaction.aborted) {
+            return false;
+        }
+        fromFinger = !deleted;
+    }
+    if (!fromFinger && !trySeekIndex(k, transaction, startNode, succ)) {
+        return false;
+    }
+
+    pred = startNode;
+    if (!tryAdvance(k, transaction, pred, succ, fromFinger)) {
+        return false;
+    }
+
+    if (transaction.type != TX_READ_ONLY) {
+        transaction.readSet.push_back(pred);
+    }
+    transaction.finger = pred;
+    transaction.fingerList = this;
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::tryAdvance(const Key & k,
+        SkipListTransaction & transaction, NodeType *& pred, NodeType *& succ,
+        bool mayReseek)
+{
+    bool deleted = false;
+    size_t hops = 0;
+    while (!transaction.aborted && succ != NULL &&
+            (index.compare(succ->key, k) || deleted)) {
+        if (mayReseek && ++hops > MAX_FINGER_HOPS) {
+            // pred is far behind k; the index gets there faster.
+            mayReseek = false;
+            if (!trySeekIndex(k, transaction, pred, succ)) {
+                return false;
+            }
+            deleted = false;
+            continue;
+        }
+        pred = succ;
+        succ = tryGetValidatedValue(transaction, pred, &deleted);
+    }
+    return !transaction.aborted;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::tryBatchSeek(const Key & k,
+        SkipListTransaction & transaction, NodeType *& pred, NodeType *& succ)
+{
+    if (!index.isHead(pred) && !index.compare(pred->key, k)) {
+        return tryTraverseTo(k, transaction, pred, succ);
+    }
+
+    NodeType * start = pred;
+    if (!tryAdvance(k, transaction, pred, succ, true)) {
+        return false;
+    }
+    if (pred != start && transaction.type != TX_READ_ONLY) {
+        transaction.readSet.push_back(pred);
+    }
+    transaction.finger = pred;
+    transaction.fingerList = this;
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+bool SkipList<Key, Value, Compare, Backend>::trySeekIndex(const Key & k,
+        SkipListTransaction & transaction, NodeType *& startNode,
+        NodeType *& succ)
+{
+    startNode = index.getPrev(k);
+    bool deleted = false;
+    succ = tryGetValidatedValue(transaction, startNode, &deleted);
+    while (!transaction.aborted && deleted) {
+        startNode = index.getPrev(startNode->key);
+        succ = tryGetValidatedValue(transaction, startNode, &deleted);
+    }
+    return !transaction.aborted;
+}
+
+template <typename Key, typename Value, typename Compare, typename Backend>
+typename SkipList<Key, Value, Compare, Backend>::NodeType *
+SkipList<Key, Value, Compare, Backend>::getFinger(SkipListTransaction & transaction,
+        const Key & k)
+{
+    if (transaction.fingerList != this) {
+        return NULL;
+    }
+
+    NodeType * finger = static_cast<NodeType *>(transaction.finger);
+    if (!index.isHead(finger) && !index.compare(finger->key, k)) {
+        return NULL;
+    }
+
+    // Fall back to the index rather than abort on a finger that another
+    // transaction locked or changed since it was read.
+    const uint64_t lockWord = finger->lock.load();
+    if (VersionedLock::isLocked(lockWord) ||
+            VersionedLock::getVersion(lockWord) > transaction.readVersion) {
+        return NULL;
+    }
+    return finger;
+}
@@ -0,0 +1,293 @@
+#include "Transaction.h"
+
+#include "SafeLock.h"
+#include "Epoch.h"
+
+// The irrevocable token. Writers announce their commits in per-thread
+// records; the holder of the token waits until none is committing, and
+// writers wait while the token is held.
+class CommitRecord
+{
+public:
+    CommitRecord() : committing(false) {}
+
+    std::atomic<bool> committing;
+};
+
+typedef ThreadRegistry<CommitRecord> CommitRecords;
+
+static std::atomic<Transaction *> irrevocableOwner(NULL);
+// Whether the calling thread holds the token. It may commit other writes
+// meanwhile: nobody else can.
+static thread_local bool holdsIrrevocable = false;
+
+static void acquireIrrevocable(Transaction * transaction)
+{
+    Transaction * expected = NULL;
+    while (!irrevocableOwner.compare_exchange_weak(expected, transaction)) {
+        expected = NULL;
+        std::this_thread::yield();
+    }
+
+    CommitRecords::forEach([](CommitRecord & r) {
+        while (r.committing.load()) {
+            std::this_thread::yield();
+        }
+    });
+    holdsIrrevocable = true;
+}
+
+// Both stores and loads are sequentially consistent: either the writer sees
+// the token, or the token holder sees the writer committing.
+static void enterCommit(CommitRecord & record)
+{
+    if (holdsIrrevocable) {
+        return;
+    }
+
+    for (;;) {
+        record.committing.store(true);
+        if (irrevocableOwner.load() == NULL) {
+            return;
+        }
+        record.committing.store(false);
+        while (irrevocableOwner.load() != NULL) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+CommitScope::CommitScope(bool announce) : record(NULL)
+{
+    if (announce) {
+        record = &CommitRecords::local();
+        enterCommit(*record);
+    }
+}
+
+CommitScope::~CommitScope()
+{
+    if (record) {
+        record->committing.store(false);
+    }
+}
+
+void Transaction::begin(GVC & gvc, TransactionType type)
+{
+    // Retrying an aborted attempt rolls it back first.
+    finish(false);
+    // Waiting for the token would wait for ourselves.
+    if (type == TX_IRREVOCABLE && holdsIrrevocable) {
+        throw std::runtime_error("The thread already runs an irrevocable transaction");
+    }
+    Epoch::enter();
+    active = true;
+
+    this->type = type;
+    aborted = false;
+    clock = &gvc;
+    // A transaction object may be reused; clearing keeps its buffers around.
+    readSet.clear();
+    writeSet.clear();
+    for (size_t i = 0; i < numEnlisted; i++) {
+        enlisted[i].indexTodo.clear();
+    }
+    numEnlisted = 0;
+    nested.clear();
+    finger = NULL;
+    fingerList = NULL;
+    if (type == TX_IRREVOCABLE) {
+        acquireIrrevocable(this);
+    }
+    readVersion = clock->read();
+}
+
+void Transaction::commit()
+{
+    if (!tryCommit()) {
+        throw AbortTransactionException();
+    }
+}
+
+bool Transaction::tryCommit()
+{
+    if (aborted) {
+        finish(false);
+        return false;
+    }
+
+    // Nothing to publish: the per-read version checks already guarantee a
+    // consistent snapshot at readVersion, so skip locking and the GVC.
+    if (writeSet.empty()) {
+        finish(true);
+        return true;
+    }
+
+    // With the token held nothing the transaction read can have changed.
+    const bool irrevocable = type == TX_IRREVOCABLE;
+    {
+        CommitScope scope(!irrevocable);
+        SafeLockList locks;
+        if (!writeSet.tryLock(locks)) {
+            markAborted(ABORT_COMMIT_LOCK);
+        } else if (!irrevocable && !validateReadSet()) {
+            markAborted(ABORT_VALIDATION);
+        } else {
+            writeVersion = clock->addAndFetch();
+            writeSet.update(writeVersion);
+            locks.dismiss();
+        }
+    }
+    if (aborted) {
+        // Only now that the locks are released may new nodes be freed.
+        finish(false);
+        return false;
+    }
+
+    clock->committed(writeVersion);
+    for (size_t i = 0; i < numEnlisted; i++) {
+        enlisted[i].tds->onCommit(enlisted[i].indexTodo);
+    }
+    finish(true);
+    return true;
+}
+
+void Transaction::abort()
+{
+    // Conflicts were counted when they were found.
+    if (active && !aborted) {
+        markAborted(ABORT_EXPLICIT);
+    }
+    aborted = true;
+    finish(false);
+}
+
+void Transaction::beginNested()
+{
+    NestedFrame frame;
+    frame.readSetSize = readSet.size();
+    frame.writes = writeSet.savepoint();
+    frame.numEnlisted = numEnlisted;
+    for (size_t i = 0; i < numEnlisted; i++) {
+        frame.todoSizes.push_back(enlisted[i].indexTodo.size());
+    }
+    frame.finger = finger;
+    frame.fingerList = fingerList;
+    nested.push_back(frame);
+}
+
+bool Transaction::tryCommitNested()
+{
+    if (nested.empty()) {
+        throw std::logic_error("No nested transaction to commit!");
+    }
+    if (aborted) {
+        abortNested();
+        return false;
+    }
+
+    writeSet.release(nested.back().writes);
+    nested.pop_back();
+    return true;
+}
+
+bool Transaction::abortNested()
+{
+    if (nested.empty()) {
+        throw std::logic_error("No nested transaction to abort!");
+    }
+    NestedFrame & frame = nested.back();
+    readSet.resize(frame.readSetSize);
+    writeSet.rollback(frame.writes);
+    for (size_t i = 0; i < numEnlisted; i++) {
+        std::vector<IndexOperation> & ops = enlisted[i].indexTodo;
+        const size_t size = i < frame.numEnlisted ? frame.todoSizes[i] : 0;
+        discardInserts(ops, size, enlisted[i].tds->destroyNode);
+        ops.erase(ops.begin() + size, ops.end());
+    }
+    numEnlisted = frame.numEnlisted;
+    // The child's finger may be one of the nodes just freed.
+    finger = frame.finger;
+    fingerList = frame.fingerList;
+    nested.pop_back();
+
+    if (type == TX_READ_ONLY) {
+        aborted = true;
+        return false;
+    }
+
+    // Whatever the parent read is still current if it has not changed since
+    // readVersion, so the parent's snapshot extends to the clock read first.
+    const VersionType extended = clock->read();
+    aborted = false;
+    if (!validateReadSet()) {
+        markAborted(ABORT_VALIDATION);
+        return false;
+    }
+    readVersion = extended;
+    return true;
+}
+
+void Transaction::discardInserts(std::vector<IndexOperation> & ops, size_t from,
+                                 Epoch::Reclaimer destroyNode)
+{
+    for (size_t i = from; i < ops.size(); i++) {
+        if (ops[i].op == OperationType::INSERT) {
+            destroyNode(ops[i].node);
+        }
+    }
+}
+
+bool Transaction::validateReadSet()
+{
+    for (auto n : readSet) {
+        const uint64_t lockWord = n->lock.load();
+        if (VersionedLock::isLocked(lockWord) && !writeSet.contains(n)) {
+            return false;
+        }
+        if (VersionedLock::getVersion(lockWord) > readVersion) {
+            clock->onAbort(VersionedLock::getVersion(lockWord));
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<IndexOperation> & Transaction::enlist(TDS * tds)
+{
+    // Transactions rarely span more than a couple of TDSs; check the most
+    // recent one first.
+    for (size_t i = numEnlisted; i > 0; i--) {
+        if (enlisted[i - 1].tds == tds) {
+            return enlisted[i - 1].indexTodo;
+        }
+    }
+
+    if (numEnlisted == enlisted.size()) {
+        enlisted.push_back(Enlistment());
+    }
+    enlisted[numEnlisted].tds = tds;
+    return enlisted[numEnlisted++].indexTodo;
+}
+
+void Transaction::finish(bool committed)
+{
+    if (!active) {
+        return;
+    }
+
+    if (!committed) {
+        for (size_t i = 0; i < numEnlisted; i++) {
+            discardInserts(enlisted[i].indexTodo, 0, enlisted[i].tds->destroyNode);
+        }
+    }
+    if (type == TX_IRREVOCABLE) {
+        holdsIrrevocable = false;
+        irrevocableOwner.store(NULL);
+    }
+    // Reused transaction objects report every transaction, not just the
+    // last one.
+    writeSet.flushFilterStats();
+    active = false;
+    Epoch::exit();
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "Utils.h"
+#include "Epoch.h"
+#include "WriteSet.h"
+#include "Node.h"
+#include "GVC.h"
+#include "Index.h"
+#include "AbortStats.h"
+
+enum TransactionType
+{
+    TX_READ_WRITE,
+    // Never records a read set and commits without locking or touching the
+    // GVC; every read is validated against readVersion as it happens.
+    TX_READ_ONLY,
+    // Holds a global token from begin to end, during which no other
+    // transaction can commit writes, so it never aborts. Meant as a fallback
+    // for transactions that keep losing (see RetryPolicy::irrevocableAfter).
+    // The token is process-wide, across all GVCs, and held for the whole
+    // transaction, reads included: while it runs, every writing commit and
+    // singleton update of every other thread waits. Its own thread may still
+    // commit other transactions and singleton updates, but not begin a
+    // second irrevocable one (begin throws std::runtime_error).
+    //
+    // The cost: a single token rather than locks taken on the nodes it
+    // touches, so read-write throughput drops to that of the irrevocable
+    // transaction alone for as long as it runs, whatever keys the others
+    // use. Reads and read-only transactions keep going. Keep irrevocable
+    // transactions short and rare.
+    TX_IRREVOCABLE
+};
+
+// Outcome of the non-throwing transactional operations.
+enum OpResult
+{
+    OP_FALSE,
+    OP_TRUE,
+    OP_ABORTED
+};
+
+class CommitRecord;
+
+// Announces a commit in progress for as long as it lives. Writers must hold
+// one while they lock nodes: it first waits while an irrevocable transaction
+// runs, which in turn waits for every announced commit to end.
+class CommitScope
+{
+public:
+    CommitScope(bool announce = true);
+
+    ~CommitScope();
+
+private:
+    CommitRecord * record;
+};
+
+// A transactional data structure that can take part in a Transaction. Its
+// nodes are validated and committed by the transaction; the structure only
+// applies the index operations it recorded once the commit succeeded.
+class TDS
+{
+public:
+    TDS(Epoch::Reclaimer destroyNode) : destroyNode(destroyNode) {}
+
+    virtual ~TDS() {}
+
+    virtual void onCommit(std::vector<IndexOperation> & ops) = 0;
+
+    // Frees one of the structure's nodes, e.g. those its aborted INSERTs
+    // created.
+    const Epoch::Reclaimer destroyNode;
+};
+
+// A transaction over any number of TDSs sharing one GVC. It begins with
+// begin() (or TXBegin of any of them), records reads and writes through
+// their operations and commits them all with a single write version.
+//
+// A transaction must begin and end on the same thread: between begin and
+// its commit (or abort) the thread stays in an Epoch critical region.
+class Transaction
+{
+public:
+    Transaction() :
+        type(TX_READ_WRITE), aborted(false), active(false), clock(NULL),
+        finger(NULL), fingerList(NULL), numEnlisted(0) {}
+
+    virtual ~Transaction()
+    {
+        finish(false);
+    }
+
+    // A TX_IRREVOCABLE transaction waits here for the token and for the
+    // commits in flight to finish.
+    void begin(GVC & gvc, TransactionType type = TX_READ_WRITE);
+
+    // Throws AbortTransactionException if the commit fails.
+    void commit();
+
+    // Locks the write set, validates the read set and, on success, publishes
+    // every write under one version and updates the indexes of all enlisted
+    // TDSs.
+    bool tryCommit();
+
+    void abort();
+
+    // Flags a conflict: every later operation reports OP_ABORTED.
+    void markAborted(AbortCause cause)
+    {
+        aborted = true;
+        AbortStats::record(cause);
+    }
+
+    // Closed nesting: the operations after beginNested form a child that
+    // commits into its parent with tryCommitNested, or is undone on its own
+    // with abortNested. Children nest. Committing or aborting a child when
+    // none is open throws std::logic_error.
+    void beginNested();
+
+    // Merges the child into its parent. If the child was aborted it is
+    // rolled back instead (see abortNested) and false is returned.
+    bool tryCommitNested();
+
+    // Undoes the child's reads, writes and index operations and revalidates
+    // the parent's read set. If the parent is still consistent its
+    // readVersion moves to the current clock, so the child can be retried;
+    // otherwise the whole transaction is aborted. Returns whether the parent
+    // survived. Read-only transactions keep no read set to revalidate, so
+    // they are always aborted as a whole.
+    bool abortNested();
+
+    size_t nestingDepth() const
+    {
+        return nested.size();
+    }
+
+    bool validateReadSet();
+
+    // The index operations recorded for tds, which joins the commit.
+    std::vector<IndexOperation> & enlist(TDS * tds);
+
+    // Leaves the epoch critical region. Nodes allocated by an uncommitted
+    // transaction were never published and are freed right away.
+    void finish(bool committed);
+
+    TransactionType type;
+    // Set by the non-throwing API once a conflict was detected; every later
+    // operation of the transaction then reports OP_ABORTED.
+    bool aborted;
+    // Between begin and the end of the commit or abort.
+    bool active;
+    // The clock readVersion came from; every enlisted TDS must use it.
+    GVC * clock;
+    VersionType readVersion;
+    VersionType writeVersion;
+    std::vector<NodeBase *> readSet;
+    WriteSet writeSet;
+    // The pred of the last traversal, and the list it belongs to. A later
+    // traversal to a greater key of the same list starts from there instead
+    // of searching the index again.
+    NodeBase * finger;
+    const void * fingerList;
+
+private:
+    class Enlistment
+    {
+    public:
+        TDS * tds;
+        std::vector<IndexOperation> indexTodo;
+    };
+
+    // Where a child transaction started in each of the parent's logs.
+    class NestedFrame
+    {
+    public:
+        size_t readSetSize;
+        WriteSet::Savepoint writes;
+        size_t numEnlisted;
+        std::vector<size_t> todoSizes;
+        NodeBase * finger;
+        const void * fingerList;
+    };
+
+    // Destroys the nodes inserted by the INSERTs in ops past from.
+    static void discardInserts(std::vector<IndexOperation> & ops, size_t from,
+                               Epoch::Reclaimer destroyNode);
+
+    // Entries past numEnlisted are kept for their buffers.
+    std::vector<Enlistment> enlisted;
+    size_t numEnlisted;
+    std::vector<NestedFrame> nested;
+};
+
+typedef Transaction SkipListTransaction;
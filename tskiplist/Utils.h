@@ -1,12 +1,94 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <unordered_map>
 #include <atomic>
 #include <mutex>
+#include <thread>
+#include <cstdint>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
 
 typedef int ItemType;
+typedef uint64_t VersionType;
 
 class AbortTransactionException : public std::exception
 {
-};
\ No newline at end of file
+};
+
+template <typename Record>
+void keepRecord(Record &) {}
+
+// Per-thread records that outlive their threads. A thread takes over a free
+// record, or adds a new one, on first use and frees it again after
+// onExit(record) when it exits; records keep their contents across owners
+// and are never deleted. Other threads may only read them.
+template <typename Record, void (*onExit)(Record &) = keepRecord<Record>>
+class ThreadRegistry
+{
+public:
+    // The calling thread's record.
+    static Record & local()
+    {
+        static thread_local Holder holder;
+        return holder.slot->record;
+    }
+
+    // Calls fn(record) for every record, including free ones.
+    template <typename Fn>
+    static void forEach(Fn fn)
+    {
+        for (Slot * s = slots().load(); s != NULL; s = s->next) {
+            fn(s->record);
+        }
+    }
+
+private:
+    class Slot
+    {
+    public:
+        Slot() : inUse(true), next(NULL) {}
+
+        Record record;
+        std::atomic<bool> inUse;
+        Slot * next;
+    };
+
+    class Holder
+    {
+    public:
+        Holder() : slot(acquire()) {}
+
+        ~Holder()
+        {
+            onExit(slot->record);
+            slot->inUse.store(false);
+        }
+
+        Slot * slot;
+    };
+
+    static std::atomic<Slot *> & slots()
+    {
+        static std::atomic<Slot *> head(NULL);
+        return head;
+    }
+
+    static Slot * acquire()
+    {
+        for (Slot * s = slots().load(); s != NULL; s = s->next) {
+            bool expected = false;
+            if (!s->inUse.load() && s->inUse.compare_exchange_strong(expected, true)) {
+                return s;
+            }
+        }
+
+        Slot * s = new Slot();
+        s->next = slots().load();
+        while (!slots().compare_exchange_weak(s->next, s)) {
+        }
+        return s;
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Utils.h"
+
+// TL2-style versioned lock: a single word whose lowest bit is the lock bit and
+// whose remaining bits hold the version of the last commit that wrote the node.
+class VersionedLock
+{
+public:
+    VersionedLock(VersionType version) : word(version << 1) {}
+
+    static bool isLocked(uint64_t w)
+    {
+        return (w & LOCK_BIT) != 0;
+    }
+
+    static VersionType getVersion(uint64_t w)
+    {
+        return w >> 1;
+    }
+
+    uint64_t load() const
+    {
+        return word.load(std::memory_order_acquire);
+    }
+
+    bool isLocked() const
+    {
+        return isLocked(load());
+    }
+
+    bool tryLock()
+    {
+        uint64_t w = word.load(std::memory_order_relaxed);
+        if (isLocked(w)) {
+            return false;
+        }
+        return word.compare_exchange_strong(w, w | LOCK_BIT,
+                                            std::memory_order_acquire);
+    }
+
+    void lock()
+    {
+        while (!tryLock()) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Releases the lock without changing the version (used on abort).
+    void unlock()
+    {
+        word.store(word.load(std::memory_order_relaxed) & ~LOCK_BIT,
+                   std::memory_order_release);
+    }
+
+    // Publishes a new version and releases the lock with a single store.
+    void unlock(VersionType newVersion)
+    {
+        word.store(newVersion << 1, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint64_t LOCK_BIT = 1;
+
+    std::atomic<uint64_t> word;
+};
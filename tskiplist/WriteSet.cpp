@@ -1,44 +1,179 @@
 #include "WriteSet.h"
 
-void WriteSet::addItem(Node * node, Node * next, bool deleted)
+// Per-thread filter counts, so that flushing after every transaction writes
+// no shared cache line.
+class FilterRecord
 {
-    const auto it = items.find(node);
-    if (it == items.end()) {
-        items.insert(std::pair<Node *, Operation>(node, Operation(next, deleted)));
-    } else {
-        if (next) {
-            it->second.next = next;
+public:
+    FilterRecord() : lookups(0), filtered(0), falsePositives(0) {}
+
+    // Only ever grow, and only the owning thread writes them, so plain loads
+    // and stores suffice.
+    std::atomic<uint64_t> lookups;
+    std::atomic<uint64_t> filtered;
+    std::atomic<uint64_t> falsePositives;
+};
+
+typedef ThreadRegistry<FilterRecord> FilterRecords;
+
+// The totals at the last resetFilterStats(), subtracted from the records
+// rather than clearing them under their owners.
+static FilterStats filterBaseline;
+static std::mutex filterBaselineMutex;
+
+static void addCount(std::atomic<uint64_t> & count, uint64_t n)
+{
+    count.store(count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static FilterStats sumFilterRecords()
+{
+    FilterStats total;
+    FilterRecords::forEach([&total](FilterRecord & r) {
+        total.lookups += r.lookups.load(std::memory_order_relaxed);
+        total.filtered += r.filtered.load(std::memory_order_relaxed);
+        total.falsePositives += r.falsePositives.load(std::memory_order_relaxed);
+    });
+    return total;
+}
+
+WriteSet::~WriteSet()
+{
+    flushFilterStats();
+}
+
+void WriteSet::flushFilterStats()
+{
+    if (stats.lookups == 0) {
+        return;
+    }
+
+    FilterRecord & record = FilterRecords::local();
+    addCount(record.lookups, stats.lookups);
+    addCount(record.filtered, stats.filtered);
+    addCount(record.falsePositives, stats.falsePositives);
+    stats = FilterStats();
+}
+
+FilterStats WriteSet::totalFilterStats()
+{
+    std::lock_guard<std::mutex> guard(filterBaselineMutex);
+    FilterStats total = sumFilterRecords();
+    total.lookups -= filterBaseline.lookups;
+    total.filtered -= filterBaseline.filtered;
+    total.falsePositives -= filterBaseline.falsePositives;
+    return total;
+}
+
+void WriteSet::resetFilterStats()
+{
+    std::lock_guard<std::mutex> guard(filterBaselineMutex);
+    filterBaseline = sumFilterRecords();
+}
+
+WriteSet::Entry * WriteSet::probe(NodeBase * node)
+{
+    Entry * entry = find(node);
+    if (!entry) {
+        stats.falsePositives++;
+    }
+    return entry;
+}
+
+WriteSet::Entry * WriteSet::find(NodeBase * node)
+{
+    if (numItems <= INLINE_CAPACITY) {
+        for (size_t i = 0; i < numItems; i++) {
+            if (inlineItems[i].node == node) {
+                return &inlineItems[i];
+            }
         }
-        if (deleted) {
-            it->second.deleted = deleted;
+        return NULL;
+    }
+
+    const size_t mask = slots.size() - 1;
+    for (size_t s = (hashNode(node) >> 32) & mask; slots[s] != 0; s = (s + 1) & mask) {
+        Entry & entry = entryAt(slots[s] - 1);
+        if (entry.node == node) {
+            return &entry;
         }
     }
+    return NULL;
 }
 
-bool WriteSet::getValue(Node * node, Node *& next, bool * deleted)
+void WriteSet::indexEntry(size_t i)
 {
-    auto it = items.find(node);
-    if (it == items.end()) {
-        return false;
+    const size_t mask = slots.size() - 1;
+    size_t s = (hashNode(entryAt(i).node) >> 32) & mask;
+    while (slots[s] != 0) {
+        s = (s + 1) & mask;
     }
+    slots[s] = (uint32_t)(i + 1);
+}
 
-    if (deleted) {
-        *deleted = it->second.deleted;
+void WriteSet::rehash()
+{
+    size_t capacity = slots.empty() ? 4 * INLINE_CAPACITY : slots.size();
+    while (capacity < 2 * numItems) {
+        capacity *= 2;
+    }
+
+    slots.assign(capacity, 0);
+    for (size_t i = 0; i < numItems; i++) {
+        indexEntry(i);
     }
+}
 
-    if (it->second.next != NULL) {
-        next = it->second.next;
+void WriteSet::addItem(NodeBase * node, NodeBase * next, bool deleted)
+{
+    const uint64_t bits = filterBits(node);
+    Entry * entry = (filter & bits) == bits ? find(node) : NULL;
+    if (entry) {
+        logUndo(*entry);
+        if (next) {
+            entry->op.next = next;
+            entry->op.hasNext = true;
+        }
+        if (deleted) {
+            entry->op.deleted = deleted;
+        }
+        return;
+    }
+
+    if (numItems < INLINE_CAPACITY) {
+        inlineItems[numItems].node = node;
+        inlineItems[numItems].op = Operation(next, deleted);
     } else {
-        next = node->next;
+        Entry spill;
+        spill.node = node;
+        spill.op = Operation(next, deleted);
+        spilled.push_back(spill);
     }
+    numItems++;
+    filter |= bits;
 
-    return true;
+    if (numItems > INLINE_CAPACITY) {
+        if (numItems == INLINE_CAPACITY + 1 || 2 * numItems > slots.size()) {
+            rehash();
+        } else {
+            indexEntry(numItems - 1);
+        }
+    }
+}
+
+void WriteSet::setNext(NodeBase * node, NodeBase * next)
+{
+    addItem(node, NULL, false);
+    // addItem logged the entry if needed.
+    Entry * entry = find(node);
+    entry->op.next = next;
+    entry->op.hasNext = true;
 }
 
 bool WriteSet::tryLock(SafeLockList & locks)
 {
-    for (auto & it : items) {
-        Node * node = it.first;
+    for (size_t i = 0; i < numItems; i++) {
+        NodeBase * node = entryAt(i).node;
         if (node->lock.tryLock()) {
             locks.add(node->lock);
         } else {
@@ -48,20 +183,90 @@ bool WriteSet::tryLock(SafeLockList & locks)
     return true;
 }
 
-void WriteSet::update(unsigned int newVersion)
+void WriteSet::update(VersionType newVersion)
 {
-    for (auto & it : items) {
-        Node * n = it.first;
-        Operation & op = it.second;
+    for (size_t i = 0; i < numItems; i++) {
+        NodeBase * n = entryAt(i).node;
+        Operation & op = entryAt(i).op;
 
         if (op.deleted) {
             n->deleted = op.deleted;
         }
 
-        if (op.next) {
+        if (op.hasNext) {
             n->next = op.next;
         }
 
-        n->version = newVersion;
+        n->lock.unlock(newVersion);
+    }
+}
+
+void WriteSet::clear()
+{
+    flushFilterStats();
+    if (numItems > INLINE_CAPACITY) {
+        std::fill(slots.begin(), slots.end(), 0);
+    }
+    spilled.clear();
+    numItems = 0;
+    filter = 0;
+    protectedItems = 0;
+    undoLog.clear();
+}
+
+void WriteSet::logUndo(Entry & entry)
+{
+    const size_t i = &entry >= inlineItems && &entry < inlineItems + INLINE_CAPACITY ?
+                     &entry - inlineItems : INLINE_CAPACITY + (&entry - spilled.data());
+    if (i < protectedItems) {
+        Undo undo;
+        undo.entry = i;
+        undo.op = entry.op;
+        undoLog.push_back(undo);
+    }
+}
+
+WriteSet::Savepoint WriteSet::savepoint()
+{
+    Savepoint savepoint;
+    savepoint.numItems = numItems;
+    savepoint.undoSize = undoLog.size();
+    savepoint.outerProtected = protectedItems;
+    protectedItems = numItems;
+    return savepoint;
+}
+
+void WriteSet::release(const Savepoint & savepoint)
+{
+    protectedItems = savepoint.outerProtected;
+    if (protectedItems == 0) {
+        undoLog.clear();
     }
-}
\ No newline at end of file
+}
+
+void WriteSet::rollback(const Savepoint & savepoint)
+{
+    while (undoLog.size() > savepoint.undoSize) {
+        entryAt(undoLog.back().entry).op = undoLog.back().op;
+        undoLog.pop_back();
+    }
+
+    if (numItems > savepoint.numItems) {
+        const bool wasIndexed = numItems > INLINE_CAPACITY;
+        numItems = savepoint.numItems;
+        spilled.resize(numItems > INLINE_CAPACITY ? numItems - INLINE_CAPACITY : 0);
+        filter = 0;
+        for (size_t i = 0; i < numItems; i++) {
+            filter |= filterBits(entryAt(i).node);
+        }
+        if (wasIndexed) {
+            std::fill(slots.begin(), slots.end(), 0);
+            if (numItems > INLINE_CAPACITY) {
+                for (size_t i = 0; i < numItems; i++) {
+                    indexEntry(i);
+                }
+            }
+        }
+    }
+    protectedItems = savepoint.outerProtected;
+}
@@ -7,24 +7,185 @@
 class Operation
 {
 public:
-    Operation(Node * next, bool deleted) : next(next), deleted(deleted) {}
+    Operation(NodeBase * next = NULL, bool deleted = false) :
+        next(next), hasNext(next != NULL), deleted(deleted) {}
 
-    Node * next;
+    NodeBase * next;
+    bool hasNext;
     bool deleted;
 };
 
+// Lookups answered by the write-set filter, summed over all write sets.
+class FilterStats
+{
+public:
+    FilterStats() : lookups(0), filtered(0), falsePositives(0) {}
+
+    uint64_t lookups;
+    // Rejected by the filter without touching the entries.
+    uint64_t filtered;
+    // Passed the filter but missed the entries.
+    uint64_t falsePositives;
+};
+
 class WriteSet
 {
 public:
-    void addItem(Node * node, Node * next, bool deleted);
+    // The state a nested transaction rolls the write set back to.
+    class Savepoint
+    {
+    public:
+        size_t numItems;
+        size_t undoSize;
+        size_t outerProtected;
+    };
+
+    WriteSet() : numItems(0), filter(0), protectedItems(0) {}
+
+    // Flushes whatever filter counts are left.
+    ~WriteSet();
+
+    // A NULL next leaves the node's successor unchanged; use setNext to
+    // record a NULL successor explicitly.
+    void addItem(NodeBase * node, NodeBase * next, bool deleted);
 
-    bool getValue(Node * node, Node *& next, bool * deleted = NULL);
+    void setNext(NodeBase * node, NodeBase * next);
+
+    bool getValue(NodeBase * node, NodeBase *& next, bool * deleted = NULL)
+    {
+        if (!mayContain(node)) {
+            return false;
+        }
+        Entry * entry = probe(node);
+        if (!entry) {
+            return false;
+        }
+
+        if (deleted) {
+            *deleted = entry->op.deleted;
+        }
+        next = entry->op.hasNext ? entry->op.next : node->next;
+        return true;
+    }
+
+    bool contains(NodeBase * node)
+    {
+        return mayContain(node) && probe(node) != NULL;
+    }
 
-    // TODO: Make sure this doesn't lock/unlock due to copy construction
     bool tryLock(SafeLockList & locks);
 
-    void update(unsigned int newVersion);
+    // Applies the pending operations and releases each lock by publishing
+    // newVersion; the SafeLockList used in tryLock must be dismissed after.
+    void update(VersionType newVersion);
+
+    // Drops all entries but keeps the storage for the next transaction.
+    // Flushes the filter counts.
+    void clear();
+
+    // Adds the filter counts gathered since the last flush to the calling
+    // thread's share of the totals.
+    void flushFilterStats();
+
+    // From here on, changes to the entries that already exist are logged so
+    // that rollback can undo them. Savepoints nest and must be released or
+    // rolled back in reverse order.
+    Savepoint savepoint();
+
+    // Keeps the changes made since the savepoint, which now belong to the
+    // enclosing one, if any.
+    void release(const Savepoint & savepoint);
+
+    // Restores the entries as they were at the savepoint.
+    void rollback(const Savepoint & savepoint);
+
+    bool empty() const
+    {
+        return numItems == 0;
+    }
+
+    size_t size() const
+    {
+        return numItems;
+    }
+
+    // Totals of everything flushed since the last reset, over all threads.
+    static FilterStats totalFilterStats();
+
+    // Safe while transactions run; only the totals start over.
+    static void resetFilterStats();
 
 private:
-    std::unordered_map<Node *, Operation> items;
+    // The first INLINE_CAPACITY entries live inside the WriteSet and are
+    // looked up by a linear scan. Larger write sets spill into a vector that
+    // is indexed by an open-addressing (linear probing) table.
+    static constexpr size_t INLINE_CAPACITY = 16;
+
+    class Entry
+    {
+    public:
+        NodeBase * node;
+        Operation op;
+    };
+
+    Entry & entryAt(size_t i)
+    {
+        return i < INLINE_CAPACITY ? inlineItems[i] : spilled[i - INLINE_CAPACITY];
+    }
+
+    static uint64_t hashNode(NodeBase * node)
+    {
+        // Fibonacci hashing; the low bits of a Node address are always zero.
+        return ((uintptr_t)node >> 4) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    // Two bits of a 64-bit Bloom filter, taken from the top of the hash.
+    static uint64_t filterBits(NodeBase * node)
+    {
+        const uint64_t hash = hashNode(node);
+        return (1ULL << (hash >> 58)) | (1ULL << ((hash >> 52) & 63));
+    }
+
+    // Lets most traversal hops skip the entry lookup: a write set usually
+    // holds few nodes, if any.
+    bool mayContain(NodeBase * node)
+    {
+        const uint64_t bits = filterBits(node);
+        stats.lookups++;
+        if ((filter & bits) != bits) {
+            stats.filtered++;
+            return false;
+        }
+        return true;
+    }
+
+    // find() for lookups that passed the filter.
+    Entry * probe(NodeBase * node);
+
+    Entry * find(NodeBase * node);
+
+    void indexEntry(size_t i);
+
+    void rehash();
+
+    void logUndo(Entry & entry);
+
+    class Undo
+    {
+    public:
+        size_t entry;
+        Operation op;
+    };
+
+    Entry inlineItems[INLINE_CAPACITY];
+    std::vector<Entry> spilled;
+    // Entry index + 1 for every used slot, 0 for an empty one.
+    std::vector<uint32_t> slots;
+    size_t numItems;
+    uint64_t filter;
+    // Entries older than the innermost savepoint; changes to them go to the
+    // undo log. Replaying it backwards restores the oldest values.
+    size_t protectedItems;
+    std::vector<Undo> undoLog;
+    FilterStats stats;
 };
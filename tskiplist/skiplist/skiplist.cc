@@ -73,6 +73,10 @@
 #define ATM_CAS(var, exp, val)      (var).compare_exchange_weak((exp), (val))
 #define ATM_FETCH_ADD(var, val)     (var).fetch_add(val, MOR)
 #define ATM_FETCH_SUB(var, val)     (var).fetch_sub(val, MOR)
+#define ATM_LOAD_ACQ(var)           (var).load(std::memory_order_acquire)
+#define ATM_FENCE_REL()             std::atomic_thread_fence(std::memory_order_release)
+#define ATM_CAS_AR(var, exp, val)   (var).compare_exchange_strong((exp), (val), \
+                                        std::memory_order_acq_rel, std::memory_order_acquire)
 #define ALLOC_(type, var, count)    (var) = new type[count]
 #define FREE_(var)                  delete[] (var)
 #else
@@ -99,11 +103,46 @@ typedef uint8_t bool;
             __atomic_compare_exchange(&(var), &(exp), &(val), 1, MOR, MOR)
 #define ATM_FETCH_ADD(var, val)     __atomic_fetch_add(&(var), (val), MOR)
 #define ATM_FETCH_SUB(var, val)     __atomic_fetch_sub(&(var), (val), MOR)
+#define ATM_LOAD_ACQ(var)           __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define ATM_FENCE_REL()             __atomic_thread_fence(__ATOMIC_RELEASE)
+#define ATM_CAS_AR(var, exp, val)   \
+            __atomic_compare_exchange(&(var), &(exp), &(val), 0, \
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
 #define ALLOC_(type, var, count)    \
             (var) = (type*)calloc(count, sizeof(type))
 #define FREE_(var)                  free(var)
 #endif
 
+static skiplist_tower_alloc_t * tower_alloc_func = NULL;
+static skiplist_tower_free_t * tower_free_func = NULL;
+
+void skiplist_set_tower_allocator(skiplist_tower_alloc_t * alloc_func,
+                                  skiplist_tower_free_t * free_func)
+{
+    tower_alloc_func = alloc_func;
+    tower_free_func = free_func;
+}
+
+static inline atm_node_ptr * _sl_alloc_tower(size_t count)
+{
+    atm_node_ptr * tower = NULL;
+    if (tower_alloc_func) {
+        tower = tower_alloc_func(count);
+    } else {
+        ALLOC_(atm_node_ptr, tower, count);
+    }
+    return tower;
+}
+
+static inline void _sl_free_tower(atm_node_ptr * tower, size_t count)
+{
+    if (tower_free_func) {
+        tower_free_func(tower, count);
+    } else {
+        FREE_(tower);
+    }
+}
+
 static inline void _sl_node_init(skiplist_node * node,
                                  size_t top_layer)
 {
@@ -119,16 +158,56 @@ static inline void _sl_node_init(skiplist_node * node,
     ATM_STORE(node->being_modified, bool_val);
     ATM_STORE(node->removed, bool_val);
 
+    if (node->fixed_tower) {
+        return;
+    }
     if (node->top_layer != top_layer ||
             node->next == NULL) {
 
-        node->top_layer = (uint8_t)top_layer;
-
         if (node->next) {
-            FREE_(node->next);
+            _sl_free_tower(node->next, node->top_layer + 1);
         }
-        ALLOC_(atm_node_ptr, node->next, top_layer + 1);
+
+        node->top_layer = (uint8_t)top_layer;
+        node->next = _sl_alloc_tower(top_layer + 1);
+    }
+}
+
+// fanout^layers, saturated: the entry count up to which `layers` layers
+// keep the complexity O(lg n).
+static inline uint32_t _sl_layer_capacity(size_t fanout, size_t layers)
+{
+    uint64_t capacity = 1;
+    size_t layer;
+    for (layer = 0; layer < layers && capacity < UINT32_MAX; ++layer) {
+        capacity *= fanout;
+    }
+    return capacity < UINT32_MAX ? (uint32_t)capacity : UINT32_MAX;
+}
+
+// Sizes head and tail for layer_limit layers up front, so that max_layer can
+// grow without touching them.
+static void _sl_init_sentinels(skiplist_raw * slist)
+{
+    if (slist->layer_entries) {
+        FREE_(slist->layer_entries);
+    }
+    ALLOC_(atm_uint32_t, slist->layer_entries, slist->layer_limit);
+
+    _sl_node_init(&slist->head, slist->layer_limit);
+    _sl_node_init(&slist->tail, slist->layer_limit);
+
+    size_t layer;
+    for (layer = 0; layer < slist->layer_limit; ++layer) {
+        slist->head.next[layer] = &slist->tail;
+        slist->tail.next[layer] = NULL;
     }
+
+    bool bool_val = true;
+    ATM_STORE(slist->head.is_fully_linked, bool_val);
+    ATM_STORE(slist->tail.is_fully_linked, bool_val);
+
+    slist->grow_at = _sl_layer_capacity(slist->fanout, slist->max_layer);
 }
 
 void skiplist_init(skiplist_raw * slist,
@@ -139,29 +218,20 @@ void skiplist_init(skiplist_raw * slist,
     slist->aux = NULL;
 
     // fanout 4 + layer 12: 4^12 ~= upto 17M items under O(lg n) complexity.
-    // for +17M items, complexity will grow linearly: O(k lg n).
+    // Beyond that, max_layer grows by one every time the size reaches
+    // fanout^max_layer, up to layer_limit.
     slist->fanout = 4;
     slist->max_layer = 12;
+    slist->layer_limit = SKIPLIST_DEFAULT_LAYER_LIMIT;
     slist->num_entries = 0;
 
-    ALLOC_(atm_uint32_t, slist->layer_entries, slist->max_layer);
+    slist->layer_entries = NULL;
     slist->top_layer = 0;
 
     skiplist_init_node(&slist->head);
     skiplist_init_node(&slist->tail);
 
-    _sl_node_init(&slist->head, slist->max_layer);
-    _sl_node_init(&slist->tail, slist->max_layer);
-
-    size_t layer;
-    for (layer = 0; layer < slist->max_layer; ++layer) {
-        slist->head.next[layer] = &slist->tail;
-        slist->tail.next[layer] = NULL;
-    }
-
-    bool bool_val = true;
-    ATM_STORE(slist->head.is_fully_linked, bool_val);
-    ATM_STORE(slist->tail.is_fully_linked, bool_val);
+    _sl_init_sentinels(slist);
     slist->cmp_func = cmp_func;
 }
 
@@ -188,12 +258,28 @@ void skiplist_init_node(skiplist_node * node)
 
     node->accessing_next = 0;
     node->top_layer = 0;
+    node->fixed_tower = 0;
     node->ref_count = 0;
 }
 
+void skiplist_init_node_with_tower(skiplist_node * node,
+                                   atm_node_ptr * tower,
+                                   size_t top_layer)
+{
+    __SLD_ASSERT(top_layer < SKIPLIST_MAX_LAYER);
+    if (node->next && !node->fixed_tower) {
+        _sl_free_tower(node->next, node->top_layer + 1);
+    }
+    node->next = tower;
+    node->top_layer = (uint8_t)top_layer;
+    node->fixed_tower = 1;
+}
+
 void skiplist_free_node(skiplist_node * node)
 {
-    FREE_(node->next);
+    if (node->next && !node->fixed_tower) {
+        _sl_free_tower(node->next, node->top_layer + 1);
+    }
     node->next = NULL;
 }
 
@@ -209,6 +295,7 @@ skiplist_raw_config skiplist_get_default_config()
     skiplist_raw_config ret;
     ret.fanout = 4;
     ret.maxLayer = 12;
+    ret.layerLimit = SKIPLIST_DEFAULT_LAYER_LIMIT;
     ret.aux = NULL;
     return ret;
 }
@@ -217,7 +304,8 @@ skiplist_raw_config skiplist_get_config(skiplist_raw * slist)
 {
     skiplist_raw_config ret;
     ret.fanout = slist->fanout;
-    ret.maxLayer = slist->max_layer;
+    ret.maxLayer = ATM_GET(slist->max_layer);
+    ret.layerLimit = slist->layer_limit;
     ret.aux = slist->aux;
     return ret;
 }
@@ -225,13 +313,25 @@ skiplist_raw_config skiplist_get_config(skiplist_raw * slist)
 void skiplist_set_config(skiplist_raw * slist,
                          skiplist_raw_config config)
 {
-    slist->fanout = (uint8_t)config.fanout;
-
-    slist->max_layer = (uint8_t)config.maxLayer;
-    if (slist->layer_entries) {
-        FREE_(slist->layer_entries);
+    size_t max_layer = config.maxLayer;
+    if (max_layer < 1) {
+        max_layer = 1;
+    }
+    if (max_layer > SKIPLIST_MAX_LAYER - 1) {
+        max_layer = SKIPLIST_MAX_LAYER - 1;
+    }
+    size_t layer_limit = config.layerLimit;
+    if (layer_limit < max_layer) {
+        layer_limit = max_layer;
+    }
+    if (layer_limit > SKIPLIST_MAX_LAYER - 1) {
+        layer_limit = SKIPLIST_MAX_LAYER - 1;
     }
-    ALLOC_(atm_uint32_t, slist->layer_entries, slist->max_layer);
+
+    slist->fanout = (uint8_t)(config.fanout < 2 ? 2 : config.fanout);
+    slist->max_layer = (uint8_t)max_layer;
+    slist->layer_limit = (uint8_t)layer_limit;
+    _sl_init_sentinels(slist);
 
     slist->aux = config.aux;
 }
@@ -395,12 +495,32 @@ static inline skiplist_node * _sl_next(skiplist_raw * slist,
     return next_node;
 }
 
+// Per-thread xorshift64*; rand() takes a lock in glibc, which serialized
+// all inserting threads.
+static inline uint64_t _sl_rand()
+{
+    static thread_local uint64_t state = 0;
+    if (state == 0) {
+        // Seeded from the address of the thread's own state.
+        state = ((uint64_t)(uintptr_t)&state + 1) * 0x9E3779B97F4A7C15ULL;
+        if (state == 0) {
+            state = 1;
+        }
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
 static inline size_t _sl_decide_top_layer(skiplist_raw * slist)
 {
     size_t layer = 0;
-    while (layer + 1 < slist->max_layer) {
+    uint8_t max_layer;
+    ATM_LOAD(slist->max_layer, max_layer);
+    while (layer + 1 < max_layer) {
         // coin filp
-        if (rand() % slist->fanout == 0) {
+        if ((_sl_rand() >> 32) % slist->fanout == 0) {
             // grow: 1/fanout probability
             layer++;
         } else {
@@ -411,6 +531,34 @@ static inline size_t _sl_decide_top_layer(skiplist_raw * slist)
     return layer;
 }
 
+size_t skiplist_choose_top_layer(skiplist_raw * slist)
+{
+    return _sl_decide_top_layer(slist);
+}
+
+// Allows one more layer once the entry count reaches fanout^max_layer.
+static inline void _sl_maybe_grow(skiplist_raw * slist, uint32_t num_entries)
+{
+    uint32_t grow_at;
+    ATM_LOAD(slist->grow_at, grow_at);
+    if (num_entries < grow_at) {
+        return;
+    }
+    uint8_t max_layer;
+    ATM_LOAD(slist->max_layer, max_layer);
+    if (max_layer >= slist->layer_limit) {
+        return;
+    }
+
+    // Whoever moves grow_at also adds the layer, so a layer is added once
+    // per threshold.
+    uint64_t next = (uint64_t)grow_at * slist->fanout;
+    uint32_t next_grow_at = next < UINT32_MAX ? (uint32_t)next : UINT32_MAX;
+    if (ATM_CAS(slist->grow_at, grow_at, next_grow_at)) {
+        ATM_FETCH_ADD(slist->max_layer, 1);
+    }
+}
+
 static inline void _sl_clr_flags(skiplist_node ** node_arr,
                                  int start_layer,
                                  int top_layer)
@@ -445,7 +593,8 @@ static inline int _skiplist_insert(skiplist_raw * slist,
         (void)tid_hash;
     )
 
-    int top_layer = (int)_sl_decide_top_layer(slist);
+    int top_layer = node->fixed_tower ? (int)node->top_layer
+                                      : (int)_sl_decide_top_layer(slist);
     bool bool_true = true;
 
     // init node before insertion
@@ -567,6 +716,8 @@ insert_retry:
             }
 
             // bottom layer => insertion succeeded
+            // optimistic readers take no lock: publish the tower first.
+            ATM_FENCE_REL();
             // change prev/next nodes' prev/next pointers from 0 ~ top_layer
             for (layer = 0; layer <= top_layer; ++layer) {
                 // `accessing_next` works as a spin-lock.
@@ -592,9 +743,10 @@ insert_retry:
 
             __SLD_P("%02x ins %p done\n", (int)tid_hash, node);
 
-            ATM_FETCH_ADD(slist->num_entries, 1);
+            uint32_t num_entries = ATM_FETCH_ADD(slist->num_entries, 1) + 1;
             ATM_FETCH_ADD(slist->layer_entries[node->top_layer], 1);
-            for (int ii = slist->max_layer - 1; ii >= 0; --ii) {
+            _sl_maybe_grow(slist, num_entries);
+            for (int ii = ATM_GET(slist->max_layer) - 1; ii >= 0; --ii) {
                 if (slist->layer_entries[ii] > 0) {
                     slist->top_layer = ii;
                     break;
@@ -707,6 +859,78 @@ find_retry:
     return NULL;
 }
 
+// Lock-free counterpart of `_sl_next`: plain loads only, validated by
+// checking that `cur_node` was still linked after its link was read.
+// Returns NULL if it was not.
+static inline skiplist_node * _sl_next_optimistic(skiplist_node * cur_node,
+                                                  int layer)
+{
+    skiplist_node * next_node = ATM_LOAD_ACQ(cur_node->next[layer]);
+    if (!_sl_valid_node(cur_node)) {
+        return NULL;
+    }
+
+    // Skip nodes being inserted or removed: their links still lead
+    // forward, and none of them is freed while the caller is protected.
+    while (next_node && !_sl_valid_node(next_node)) {
+        next_node = ATM_LOAD_ACQ(next_node->next[layer]);
+    }
+    return next_node;
+}
+
+// `_sl_find` without ref counts or `accessing_next` locks, so lookups write
+// no shared cache line. The returned node's ref_count is not increased.
+static inline skiplist_node * _sl_find_optimistic(skiplist_raw * slist,
+                                                  skiplist_node * query,
+                                                  _sl_find_mode mode)
+{
+find_retry:
+    (void)mode;
+    int cmp = 0;
+    int cur_layer = 0;
+    skiplist_node * cur_node = &slist->head;
+
+    uint8_t sl_top_layer = slist->top_layer;
+    for (cur_layer = sl_top_layer; cur_layer >= 0; --cur_layer) {
+        do {
+            skiplist_node * next_node = _sl_next_optimistic(cur_node, cur_layer);
+            if (!next_node) {
+                YIELD();
+                goto find_retry;
+            }
+            cmp = _sl_cmp(slist, query, next_node);
+            if (cmp > 0) {
+                // cur_node < next_node < query
+                // => move to next node
+                cur_node = next_node;
+                continue;
+            } else if (-1 <= mode && mode <= 1 && cmp == 0) {
+                // cur_node < query == next_node .. return
+                return next_node;
+            }
+
+            // otherwise: cur_node < query < next_node
+            if (cur_layer) {
+                // non-bottom layer => go down
+                break;
+            }
+
+            // bottom layer
+            if (mode < 0 && cur_node != &slist->head) {
+                // smaller mode
+                return cur_node;
+            } else if (mode > 0 && next_node != &slist->tail) {
+                // greater mode
+                return next_node;
+            }
+            // otherwise: exact match mode OR not found
+            return NULL;
+        } while (cur_node != &slist->tail);
+    }
+
+    return NULL;
+}
+
 skiplist_node * skiplist_find(skiplist_raw * slist,
                               skiplist_node * query)
 {
@@ -725,6 +949,24 @@ skiplist_node * skiplist_find_greater_or_equal(skiplist_raw * slist,
     return _sl_find(slist, query, GTEQ);
 }
 
+skiplist_node * skiplist_find_optimistic(skiplist_raw * slist,
+                                         skiplist_node * query)
+{
+    return _sl_find_optimistic(slist, query, EQ);
+}
+
+skiplist_node * skiplist_find_smaller_or_equal_optimistic(skiplist_raw * slist,
+        skiplist_node * query)
+{
+    return _sl_find_optimistic(slist, query, SM);
+}
+
+skiplist_node * skiplist_find_greater_or_equal_optimistic(skiplist_raw * slist,
+        skiplist_node * query)
+{
+    return _sl_find_optimistic(slist, query, GTEQ);
+}
+
 int skiplist_erase_node_passive(skiplist_raw * slist,
                                 skiplist_node * node)
 {
@@ -908,7 +1150,7 @@ erase_node_retry:
 
     ATM_FETCH_SUB(slist->num_entries, 1);
     ATM_FETCH_SUB(slist->layer_entries[node->top_layer], 1);
-    for (int ii = slist->max_layer - 1; ii >= 0; --ii) {
+    for (int ii = ATM_GET(slist->max_layer) - 1; ii >= 0; --ii) {
         if (slist->layer_entries[ii] > 0) {
             slist->top_layer = ii;
             break;
@@ -1065,4 +1307,211 @@ skiplist_node * skiplist_begin(skiplist_raw * slist)
 skiplist_node * skiplist_end(skiplist_raw * slist)
 {
     return skiplist_prev(slist, &slist->tail);
-}
\ No newline at end of file
+}
+
+// Lock-free variant (Herlihy & Shavit's LockFreeSkipList, after Fraser).
+//
+// Links carry a mark in their lowest bit: a node is logically removed once
+// its bottom link is marked, and whoever traverses a marked link unlinks
+// the node at that layer with a CAS on its predecessor. Ties between equal
+// keys are broken by node address, so every node has a unique position and
+// duplicate keys need no special case. Nodes are never locked and no
+// operation waits for another; in exchange nothing here frees a node, which
+// must stay valid until no traversal can reach it (e.g. through epochs).
+
+static inline skiplist_node * _sl_lf_ptr(skiplist_node * link)
+{
+    return (skiplist_node *)((uintptr_t)link & ~(uintptr_t)1);
+}
+
+static inline bool _sl_lf_marked(skiplist_node * link)
+{
+    return ((uintptr_t)link & 1) != 0;
+}
+
+static inline skiplist_node * _sl_lf_mark(skiplist_node * link)
+{
+    return (skiplist_node *)((uintptr_t)link | 1);
+}
+
+static inline skiplist_node * _sl_lf_next(skiplist_node * node, int layer)
+{
+    return ATM_LOAD_ACQ(node->next[layer]);
+}
+
+static inline bool _sl_lf_cas(skiplist_node * node, int layer,
+                              skiplist_node * exp, skiplist_node * val)
+{
+    return ATM_CAS_AR(node->next[layer], exp, val);
+}
+
+static inline int _sl_lf_cmp(skiplist_raw * slist,
+                             skiplist_node * a,
+                             skiplist_node * b)
+{
+    int cmp = _sl_cmp(slist, a, b);
+    if (cmp != 0 || a == b) {
+        return cmp;
+    }
+    return a < b ? -1 : 1;
+}
+
+// Fills prevs/nexts for layers 0 ~ top_layer around `node`, unlinking every
+// marked node on the way. Returns whether `node` is linked at the bottom.
+static bool _sl_lf_find(skiplist_raw * slist,
+                        skiplist_node * node,
+                        int top_layer,
+                        skiplist_node ** prevs,
+                        skiplist_node ** nexts)
+{
+find_retry:
+    skiplist_node * prev = &slist->head;
+    int layer;
+    for (layer = top_layer; layer >= 0; --layer) {
+        skiplist_node * cur = _sl_lf_ptr(_sl_lf_next(prev, layer));
+        while (cur != &slist->tail) {
+            skiplist_node * next = _sl_lf_next(cur, layer);
+            if (_sl_lf_marked(next)) {
+                if (!_sl_lf_cas(prev, layer, cur, _sl_lf_ptr(next))) {
+                    goto find_retry;
+                }
+                cur = _sl_lf_ptr(next);
+                continue;
+            }
+            if (_sl_lf_cmp(slist, cur, node) >= 0) {
+                break;
+            }
+            prev = cur;
+            cur = next;
+        }
+        prevs[layer] = prev;
+        nexts[layer] = cur;
+    }
+    return nexts[0] == node;
+}
+
+int skiplist_lf_insert(skiplist_raw * slist,
+                       skiplist_node * node)
+{
+    int top_layer = node->fixed_tower ? (int)node->top_layer
+                                      : (int)_sl_decide_top_layer(slist);
+    _sl_node_init(node, top_layer);
+
+    int search_layer = slist->top_layer;
+    if (top_layer > search_layer) {
+        search_layer = top_layer;
+    }
+
+    skiplist_node * prevs[SKIPLIST_MAX_LAYER];
+    skiplist_node * nexts[SKIPLIST_MAX_LAYER];
+    int layer;
+    do {
+        _sl_lf_find(slist, node, search_layer, prevs, nexts);
+        for (layer = 0; layer <= top_layer; ++layer) {
+            ATM_STORE(node->next[layer], nexts[layer]);
+        }
+        // Linked at the bottom: the node is in the list.
+    } while (!_sl_lf_cas(prevs[0], 0, nexts[0], node));
+
+    for (layer = 1; layer <= top_layer; ++layer) {
+        while (!_sl_lf_cas(prevs[layer], layer, nexts[layer], node)) {
+            _sl_lf_find(slist, node, search_layer, prevs, nexts);
+            skiplist_node * link = _sl_lf_next(node, layer);
+            if (_sl_lf_marked(link) ||
+                    !_sl_lf_cas(node, layer, link, nexts[layer])) {
+                // removed meanwhile: leave the upper layers alone
+                goto insert_done;
+            }
+        }
+    }
+
+insert_done:
+    bool bool_true = true;
+    ATM_STORE(node->is_fully_linked, bool_true);
+
+    uint32_t num_entries = ATM_FETCH_ADD(slist->num_entries, 1) + 1;
+    ATM_FETCH_ADD(slist->layer_entries[node->top_layer], 1);
+    _sl_maybe_grow(slist, num_entries);
+    for (int ii = ATM_GET(slist->max_layer) - 1; ii >= 0; --ii) {
+        if (slist->layer_entries[ii] > 0) {
+            slist->top_layer = ii;
+            break;
+        }
+    }
+    return 0;
+}
+
+int skiplist_lf_erase_node(skiplist_raw * slist,
+                           skiplist_node * node)
+{
+    if (!_sl_valid_node(node)) {
+        // never inserted, or its insertion has not finished
+        return -1;
+    }
+
+    int top_layer = node->top_layer;
+    int layer;
+    for (layer = top_layer; layer >= 1; --layer) {
+        skiplist_node * next = _sl_lf_next(node, layer);
+        while (!_sl_lf_marked(next)) {
+            _sl_lf_cas(node, layer, next, _sl_lf_mark(next));
+            next = _sl_lf_next(node, layer);
+        }
+    }
+
+    // Whoever marks the bottom link removes the node.
+    skiplist_node * next = _sl_lf_next(node, 0);
+    for (;;) {
+        if (_sl_lf_marked(next)) {
+            return -1;
+        }
+        if (_sl_lf_cas(node, 0, next, _sl_lf_mark(next))) {
+            break;
+        }
+        next = _sl_lf_next(node, 0);
+    }
+
+    bool bool_true = true;
+    ATM_STORE(node->removed, bool_true);
+
+    // Unlinks it from every layer.
+    int search_layer = slist->top_layer;
+    if (top_layer > search_layer) {
+        search_layer = top_layer;
+    }
+    skiplist_node * prevs[SKIPLIST_MAX_LAYER];
+    skiplist_node * nexts[SKIPLIST_MAX_LAYER];
+    _sl_lf_find(slist, node, search_layer, prevs, nexts);
+
+    ATM_FETCH_SUB(slist->num_entries, 1);
+    ATM_FETCH_SUB(slist->layer_entries[top_layer], 1);
+    for (int ii = ATM_GET(slist->max_layer) - 1; ii >= 0; --ii) {
+        if (slist->layer_entries[ii] > 0) {
+            slist->top_layer = ii;
+            break;
+        }
+    }
+    return 0;
+}
+
+skiplist_node * skiplist_lf_find_smaller(skiplist_raw * slist,
+                                         skiplist_node * query)
+{
+    skiplist_node * prev = &slist->head;
+    int layer;
+    for (layer = slist->top_layer; layer >= 0; --layer) {
+        skiplist_node * cur = _sl_lf_ptr(_sl_lf_next(prev, layer));
+        while (cur != &slist->tail) {
+            skiplist_node * next = _sl_lf_next(cur, layer);
+            // Skip removed nodes without helping to unlink them.
+            if (!_sl_lf_marked(next)) {
+                if (_sl_cmp(slist, cur, query) >= 0) {
+                    break;
+                }
+                prev = cur;
+            }
+            cur = _sl_lf_ptr(next);
+        }
+    }
+    return prev == &slist->head ? NULL : prev;
+}
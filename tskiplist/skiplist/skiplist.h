@@ -36,6 +36,7 @@
 #include <stdint.h>
 
 #define SKIPLIST_MAX_LAYER (64)
+#define SKIPLIST_DEFAULT_LAYER_LIMIT (32)
 
 struct _skiplist_node;
 
@@ -69,6 +70,8 @@ typedef struct _skiplist_node
     atm_bool being_modified;
     atm_bool removed;
     uint8_t top_layer; // 0: bottom
+    // The tower belongs to the caller (see skiplist_init_node_with_tower).
+    uint8_t fixed_tower;
     atm_uint16_t ref_count;
     atm_uint32_t accessing_next;
 } skiplist_node;
@@ -81,7 +84,10 @@ typedef int skiplist_cmp_t(skiplist_node * a, skiplist_node * b, void * aux);
 typedef struct
 {
     size_t fanout;
+    // Layers a node may span at first. Whenever the number of entries
+    // reaches fanout^maxLayer, one more is allowed, up to layerLimit.
     size_t maxLayer;
+    size_t layerLimit;
     void * aux;
 } skiplist_raw_config;
 
@@ -95,7 +101,10 @@ typedef struct
     atm_uint32_t * layer_entries;
     atm_uint8_t top_layer;
     uint8_t fanout;
-    uint8_t max_layer;
+    atm_uint8_t max_layer;
+    uint8_t layer_limit;
+    // Entry count at which max_layer grows next.
+    atm_uint32_t grow_at;
 } skiplist_raw;
 
 #ifndef _get_entry
@@ -103,6 +112,15 @@ typedef struct
         ((STRUCT *) ((uint8_t *) (ELEM) - offsetof (STRUCT, MEMBER)))
 #endif
 
+// Allocator for the `next` towers of nodes: `count` zeroed pointers.
+// Installed process-wide, before the first skiplist is initialized;
+// defaults to calloc/free.
+typedef atm_node_ptr * skiplist_tower_alloc_t(size_t count);
+typedef void skiplist_tower_free_t(atm_node_ptr * tower, size_t count);
+
+void skiplist_set_tower_allocator(skiplist_tower_alloc_t * alloc_func,
+                                  skiplist_tower_free_t * free_func);
+
 void skiplist_init(skiplist_raw * slist,
                    skiplist_cmp_t * cmp_func);
 void skiplist_free(skiplist_raw * slist);
@@ -110,11 +128,24 @@ void skiplist_free(skiplist_raw * slist);
 void skiplist_init_node(skiplist_node * node);
 void skiplist_free_node(skiplist_node * node);
 
+// Gives a node a caller-owned tower of top_layer + 1 zeroed pointers, e.g.
+// allocated along with the node itself. The node is inserted with exactly
+// that height, and skiplist_free_node leaves the tower alone. top_layer
+// should come from skiplist_choose_top_layer of the skiplist it joins.
+void skiplist_init_node_with_tower(skiplist_node * node,
+                                   atm_node_ptr * tower,
+                                   size_t top_layer);
+
+// A random height for a new node: layer l + 1 with probability 1/fanout of
+// layer l, below the current max layer.
+size_t skiplist_choose_top_layer(skiplist_raw * slist);
+
 size_t skiplist_get_size(skiplist_raw * slist);
 
 skiplist_raw_config skiplist_get_default_config();
 skiplist_raw_config skiplist_get_config(skiplist_raw * slist);
 
+// Only for an empty skiplist.
 void skiplist_set_config(skiplist_raw * slist,
                          skiplist_raw_config config);
 
@@ -130,6 +161,35 @@ skiplist_node * skiplist_find_smaller_or_equal(skiplist_raw * slist,
 skiplist_node * skiplist_find_greater_or_equal(skiplist_raw * slist,
         skiplist_node * query);
 
+// The same lookups without ref counts or locks: they only read shared
+// memory, but the caller must make sure that no node is freed while they
+// run (e.g. by epoch-based reclamation), and must not release the result.
+skiplist_node * skiplist_find_optimistic(skiplist_raw * slist,
+        skiplist_node * query);
+skiplist_node * skiplist_find_smaller_or_equal_optimistic(skiplist_raw * slist,
+        skiplist_node * query);
+skiplist_node * skiplist_find_greater_or_equal_optimistic(skiplist_raw * slist,
+        skiplist_node * query);
+
+// A lock-free alternative to insert, erase_node and find_smaller, built on
+// marked links instead of node flags and locks. A skiplist is updated and
+// searched either only with these or only with the lock-based functions;
+// initialization, configuration and size are shared. Nodes with equal keys
+// may coexist. Like the optimistic lookups they keep no ref counts: a node
+// removed with skiplist_lf_erase_node, which is unlinked from every layer
+// when the call returns, may only be freed once no concurrent operation
+// can still be traversing it.
+int skiplist_lf_insert(skiplist_raw * slist,
+                       skiplist_node * node);
+// Returns -1 if the node is not (or not yet fully) inserted, or was
+// already removed. Inserting and erasing the same node concurrently is not
+// supported.
+int skiplist_lf_erase_node(skiplist_raw * slist,
+                           skiplist_node * node);
+// The last node smaller than query that is not being removed, or NULL.
+skiplist_node * skiplist_lf_find_smaller(skiplist_raw * slist,
+        skiplist_node * query);
+
 int skiplist_erase_node_passive(skiplist_raw * slist,
                                 skiplist_node * node);
 int skiplist_erase_node(skiplist_raw * slist,